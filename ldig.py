@@ -5,7 +5,7 @@
 # This code is available under the MIT License.
 # (c)2011 Nakatani Shuyo / Cybozu Labs Inc.
 
-import os, sys, re, codecs, json
+import os, sys, re, codecs, json, gzip
 import optparse
 import numpy
 import htmlentitydefs
@@ -28,14 +28,15 @@ class ldig(object):
     def load_features(self):
         features = []
         with codecs.open(self.features, 'rb',  'utf-8') as f:
-            pre_feature = ""
+            # features may be in any order (native/ldigrenum renumbers them)
+            seen = set()
             for n, s in enumerate(f):
                 m = re.match(r'(.+)\t([0-9]+)', s)
                 if not m:
                     sys.exit("irregular feature : '%s' at %d" % (s, n + 1))
-                if pre_feature >= m.groups(1):
-                    sys.exit("unordered feature : '%s' at %d" % (s, n + 1))
-                pre_feature = m.groups(1)
+                if m.group(1) in seen:
+                    sys.exit("duplicated feature : '%s' at %d" % (s, n + 1))
+                seen.add(m.group(1))
                 features.append(m.groups())
         return features
 
@@ -56,7 +57,7 @@ class ldig(object):
         labels = []
         with codecs.open(temp_path, 'wb', 'utf-8') as f:
             for file in corpus_list:
-                with codecs.open(file, 'rb', 'utf-8') as g:
+                with open_corpus(file) as g:
                     for i, s in enumerate(g):
                         label, text, org_text =  normalize_text(s)
                         if label is None or label == "":
@@ -107,16 +108,17 @@ class ldig(object):
         param = numpy.load(self.param)
 
         list = (numpy.abs(param).sum(1) > 0.0000001)
-        new_param = param[list]
+        # DoubleArray.initialize needs sorted features
+        ids = sorted(numpy.flatnonzero(list), key=lambda i:features[i][0])
+        new_param = param[ids]
         print "# of features : %d => %d" % (param.shape[0], new_param.shape[0])
 
         numpy.save(self.param, new_param)
         new_features = []
         with codecs.open(self.features, 'wb',  'utf-8') as f:
-            for i, x in enumerate(list):
-                if x:
-                    f.write("%s\t%s\n" % features[i])
-                    new_features.append(features[i][0])
+            for i in ids:
+                f.write("%s\t%s\n" % features[i])
+                new_features.append(features[i][0])
 
         generate_doublearray(self.doublearray, new_features)
 
@@ -278,12 +280,18 @@ def normalize_text(org):
     return label, s.strip(), org
 
 
+# open corpus file (gzip if .gz)
+def open_corpus(filename):
+    if filename.endswith('.gz'):
+        return codecs.getreader('utf-8')(gzip.open(filename, 'rb'))
+    return codecs.open(filename, 'rb',  'utf-8')
+
 # load courpus
 def load_corpus(filelist, labels):
     idlist = dict((x, []) for x in labels)
     corpus = []
     for filename in filelist:
-        f = codecs.open(filename, 'rb',  'utf-8')
+        f = open_corpus(filename)
         for i, s in enumerate(f):
             label, text, org_text = normalize_text(s)
             if label not in labels:
@@ -401,7 +409,7 @@ def likelihood(param, labels, trie, filelist, options):
     n_available_data = 0
     log_likely = 0.0
     for filename in filelist:
-        f = codecs.open(filename, 'rb',  'utf-8')
+        f = open_corpus(filename)
         for i, s in enumerate(f):
             label, text, org_text = normalize_text(s)
 
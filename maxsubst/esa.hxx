@@ -32,8 +32,9 @@
 #include "sais.hxx"
 
 namespace esaxx_private {
+// SA => PLCP in R (L is used for Psi)
 template<typename string_type, typename sarray_type, typename index_type>
-index_type suffixtree(string_type T, sarray_type SA, sarray_type L, sarray_type R, sarray_type D, index_type n){
+void plcp(string_type T, sarray_type SA, sarray_type L, sarray_type R, index_type n){
   sarray_type Psi = L;
   for (index_type i = 1; i < n; ++i){
     Psi[SA[i]] = SA[i-1];
@@ -53,7 +54,37 @@ index_type suffixtree(string_type T, sarray_type SA, sarray_type L, sarray_type
     PLCP[i] = h;
     if (h > 0) --h;
   }
+}
+
+// SA => PLCP in R (L is used for Psi) of the suffixes bounded by sep:
+// a suffix ends with the first sep after its head, so no common prefix
+// (and no internal node) spans a sep, except for the sep at the head
+template<typename string_type, typename sarray_type, typename index_type, typename char_type>
+void plcp_bounded(string_type T, sarray_type SA, sarray_type L, sarray_type R, index_type n, char_type sep){
+  sarray_type Psi = L;
+  for (index_type i = 1; i < n; ++i){
+    Psi[SA[i]] = SA[i-1];
+  }
+
+  // PLCP[i+1] >= PLCP[i] - 1 holds for the bounded suffixes too
+  sarray_type PLCP = R;
+  index_type h = 0;
+  for (index_type i = 0; i < n; ++i){
+    index_type j = Psi[i];
+    // h may already end with the sep carried from i-1
+    while (!(h > 1 && T[i+h-1] == sep) && i+h < n && j+h < n &&
+	   T[i+h] == T[j+h]){
+      ++h;
+    }
+    PLCP[i] = h;
+    if (h > 0) --h;
+  }
+}
 
+// PLCP in R (by plcp) => internal nodes in L, R and D
+template<typename sarray_type, typename index_type>
+index_type lcptree(sarray_type SA, sarray_type L, sarray_type R, sarray_type D, index_type n){
+  sarray_type PLCP = R;
   sarray_type H = L;
   for (index_type i = 0; i < n; ++i){
     H[i] = PLCP[SA[i]];
@@ -85,6 +116,12 @@ index_type suffixtree(string_type T, sarray_type SA, sarray_type L, sarray_type
   }
   return nodeNum;
 }
+
+template<typename string_type, typename sarray_type, typename index_type>
+index_type suffixtree(string_type T, sarray_type SA, sarray_type L, sarray_type R, sarray_type D, index_type n){
+  plcp(T, SA, L, R, n);
+  return lcptree(SA, L, R, D, n);
+}
 }
 
 /**
@@ -0,0 +1,445 @@
+#pragma once
+/**
+	@file
+	@brief reader of gzip files (self-contained inflate of RFC 1951 and 1952)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "cybozu/inttype.hpp"
+#include "cybozu/exception.hpp"
+
+namespace gzip {
+
+namespace local {
+
+struct CrcTable {
+	uint32_t tbl[256];
+	CrcTable()
+	{
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int j = 0; j < 8; j++) c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			tbl[i] = c;
+		}
+	}
+};
+
+/**
+	canonical Huffman code of deflate
+	the codes up to fastBits are decoded by a table, and the longer ones bit by bit
+*/
+struct Huffman {
+	static const int fastBits = 10;
+	uint16_t count[16];   //!< codes of each length
+	uint16_t symbol[288]; //!< symbols ordered by their codes
+	uint16_t fast[1 << fastBits]; //!< symbol << 4 | length by the next bits (0 if the code is longer)
+	/**
+		@return false if the lengths are over-subscribed
+	*/
+	bool build(const unsigned char *length, int n)
+	{
+		memset(count, 0, sizeof(count));
+		for (int i = 0; i < n; i++) count[length[i]]++;
+		count[0] = 0;
+		int left = 1;
+		for (int len = 1; len < 16; len++) {
+			left = (left << 1) - count[len];
+			if (left < 0) return false;
+		}
+		uint16_t offs[16];
+		offs[1] = 0;
+		for (int len = 1; len < 15; len++) offs[len + 1] = offs[len] + count[len];
+		for (int i = 0; i < n; i++) {
+			if (length[i]) symbol[offs[length[i]]++] = (uint16_t)i;
+		}
+		/* codes are packed from the most significant bit, so the table is indexed by the reversed codes */
+		memset(fast, 0, sizeof(fast));
+		int code = 0, k = 0;
+		for (int len = 1; len <= fastBits; len++) {
+			for (int i = 0; i < count[len]; i++, k++, code++) {
+				int r = 0;
+				for (int b = 0; b < len; b++) r |= ((code >> b) & 1) << (len - 1 - b);
+				for (int j = r; j < (1 << fastBits); j += 1 << len) fast[j] = (uint16_t)(symbol[k] << 4 | len);
+			}
+			code <<= 1;
+		}
+		return true;
+	}
+};
+
+const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+} // local
+
+/**
+	CRC-32 (of gzip and zip) of [p, p + n) continued from crc (0 at first)
+*/
+inline uint32_t crc32(uint32_t crc, const char *p, size_t n)
+{
+	static const local::CrcTable t; // initialized once by callers of any thread
+	crc = ~crc;
+	for (size_t i = 0; i < n; i++) crc = t.tbl[(crc ^ (unsigned char)p[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+/**
+	@return true if the file begins with the magic of gzip
+*/
+inline bool isGzip(const std::string& path)
+{
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (fp == 0) return false;
+	unsigned char magic[2];
+	const bool ret = fread(magic, 1, 2, fp) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+	fclose(fp);
+	return ret;
+}
+
+/**
+	stream of the decompressed data of a gzip file
+	(concatenated members are read as one stream as gzip -d)
+*/
+class Reader {
+	static const size_t window = 1 << 15;
+	FILE *fp_;
+	std::string path_;
+	std::vector<char> in_;
+	size_t inPos_, inEnd_;
+	bool inEof_;
+	uint64_t bits_;
+	int nbits_;
+	size_t padding_; //!< zero bytes put after the end of file
+	std::vector<char> out_; //!< [0, outEnd_) decoded, which has the window before outEnd_
+	size_t outPos_, outEnd_;
+	size_t crcPos_;
+	uint32_t crc_;
+	uint32_t size_;
+	enum State { stHeader, stBlock, stStored, stHuffman, stTrailer, stEnd } state_;
+	bool last_;
+	size_t stored_;
+	bool first_;
+	local::Huffman lit_, dist_;
+	Reader(const Reader&);
+	void operator=(const Reader&);
+
+	void error(const char *msg) const
+	{
+		cybozu::Exception e("gzip");
+		e << msg << path_;
+		throw e;
+	}
+	void refill()
+	{
+		while (nbits_ <= 56) {
+			if (inPos_ == inEnd_) {
+				if (!inEof_) {
+					inEnd_ = fread(&in_[0], 1, in_.size(), fp_);
+					inPos_ = 0;
+					if (inEnd_ < in_.size()) inEof_ = true;
+				}
+				if (inPos_ == inEnd_) {
+					padding_++;
+					nbits_ += 8;
+					continue;
+				}
+			}
+			bits_ |= (uint64_t)(unsigned char)in_[inPos_++] << nbits_;
+			nbits_ += 8;
+		}
+	}
+	/* the bits after the end of file are consumed */
+	bool truncated() const { return (int)padding_ * 8 > nbits_; }
+	uint32_t bits(int n)
+	{
+		if (nbits_ < n) refill();
+		const uint32_t v = (uint32_t)(bits_ & ((1ULL << n) - 1));
+		bits_ >>= n;
+		nbits_ -= n;
+		return v;
+	}
+	void align() { bits(nbits_ & 7); }
+	/* no more bytes of the file */
+	bool atEnd()
+	{
+		align();
+		refill();
+		return nbits_ <= (int)padding_ * 8;
+	}
+	int decode(const local::Huffman& h)
+	{
+		const int e = h.fast[bits_ & ((1 << local::Huffman::fastBits) - 1)];
+		if (e) {
+			bits_ >>= e & 15;
+			nbits_ -= e & 15;
+			return e >> 4;
+		}
+		int code = 0, first = 0, index = 0;
+		for (int len = 1; len < 16; len++) {
+			code |= (int)((bits_ >> (len - 1)) & 1);
+			const int count = h.count[len];
+			if (code - first < count) {
+				bits_ >>= len;
+				nbits_ -= len;
+				return h.symbol[index + code - first];
+			}
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+		error("bad code");
+		return -1;
+	}
+	void readHeader()
+	{
+		if (!first_ && atEnd()) {
+			state_ = stEnd;
+			return;
+		}
+		const uint32_t id1 = bits(8), id2 = bits(8);
+		if (id1 != 0x1f || id2 != 0x8b) {
+			if (first_) error("not gzip");
+			/* trailing garbage is ignored as gzip -d */
+			state_ = stEnd;
+			return;
+		}
+		if (bits(8) != 8) error("unknown method");
+		const uint32_t flags = bits(8);
+		bits(16); bits(16); // mtime
+		bits(16); // xfl, os
+		if (flags & 4) {
+			for (uint32_t n = bits(16); n > 0; n--) bits(8);
+		}
+		if (flags & 8) {
+			while (bits(8) != 0 && !truncated()) { }
+		}
+		if (flags & 16) {
+			while (bits(8) != 0 && !truncated()) { }
+		}
+		if (flags & 2) bits(16);
+		if (truncated()) error("unexpected end");
+		first_ = false;
+		crc_ = 0;
+		size_ = 0;
+		crcPos_ = outEnd_;
+		state_ = stBlock;
+	}
+	void readBlock()
+	{
+		last_ = bits(1) != 0;
+		const uint32_t type = bits(2);
+		if (type == 0) {
+			align();
+			const uint32_t len = bits(16), nlen = bits(16);
+			if ((len ^ 0xffff) != nlen) error("bad stored block");
+			stored_ = len;
+			state_ = stStored;
+		} else if (type == 1) {
+			unsigned char length[288 + 32];
+			memset(length, 8, 144);
+			memset(length + 144, 9, 112);
+			memset(length + 256, 7, 24);
+			memset(length + 280, 8, 8);
+			lit_.build(length, 288);
+			memset(length, 5, 30);
+			dist_.build(length, 30);
+			state_ = stHuffman;
+		} else if (type == 2) {
+			readDynamic();
+			state_ = stHuffman;
+		} else {
+			error("bad block type");
+		}
+		if (truncated()) error("unexpected end");
+	}
+	void readDynamic()
+	{
+		static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+		const int nlen = bits(5) + 257, ndist = bits(5) + 1, ncode = bits(4) + 4;
+		if (nlen > 286 || ndist > 30) error("bad lengths");
+		unsigned char length[288 + 32];
+		memset(length, 0, 19);
+		for (int i = 0; i < ncode; i++) length[order[i]] = (unsigned char)bits(3);
+		local::Huffman lencode;
+		if (!lencode.build(length, 19)) error("bad code lengths");
+		for (int i = 0; i < nlen + ndist;) {
+			if (nbits_ < 32) refill();
+			const int sym = decode(lencode);
+			if (sym < 16) {
+				length[i++] = (unsigned char)sym;
+				continue;
+			}
+			int len = 0, rep;
+			if (sym == 16) {
+				if (i == 0) error("bad repeat");
+				len = length[i - 1];
+				rep = 3 + bits(2);
+			} else if (sym == 17) {
+				rep = 3 + bits(3);
+			} else {
+				rep = 11 + bits(7);
+			}
+			if (i + rep > nlen + ndist) error("bad repeat");
+			while (rep-- > 0) length[i++] = (unsigned char)len;
+		}
+		if (length[256] == 0) error("no end of block");
+		if (!lit_.build(length, nlen) || !dist_.build(length + nlen, ndist)) error("bad lengths");
+	}
+	/* decode the symbols of the block until the output reaches limit */
+	void inflate(size_t limit)
+	{
+		char *out = &out_[0];
+		size_t end = outEnd_;
+		while (end < limit) {
+			refill();
+			const int sym = decode(lit_);
+			if (sym < 256) {
+				out[end++] = (char)sym;
+				continue;
+			}
+			if (sym == 256) {
+				state_ = last_ ? stTrailer : stBlock;
+				break;
+			}
+			if (sym > 285) error("bad length");
+			const int len = local::lengthBase[sym - 257] + bits(local::lengthExtra[sym - 257]);
+			const int d = decode(dist_);
+			if (d >= 30) error("bad distance");
+			const size_t dist = local::distBase[d] + bits(local::distExtra[d]);
+			if (dist > end) error("bad distance");
+			const char *from = out + end - dist;
+			for (int i = 0; i < len; i++) out[end + i] = from[i];
+			end += len;
+		}
+		outEnd_ = end;
+		if (truncated()) error("unexpected end");
+	}
+	void copyStored(size_t limit)
+	{
+		while (stored_ > 0 && outEnd_ < limit) {
+			size_t n = std::min(stored_, limit - outEnd_);
+			if (nbits_ >= 8) {
+				n = 1;
+				out_[outEnd_] = (char)bits(8);
+			} else {
+				if (inPos_ == inEnd_) {
+					refill(); // next bytes into bits_
+					if (truncated()) error("unexpected end");
+					continue;
+				}
+				n = std::min(n, inEnd_ - inPos_);
+				memcpy(&out_[outEnd_], &in_[inPos_], n);
+				inPos_ += n;
+			}
+			outEnd_ += n;
+			stored_ -= n;
+		}
+		if (truncated()) error("unexpected end");
+		if (stored_ == 0) state_ = last_ ? stTrailer : stBlock;
+	}
+	void readTrailer()
+	{
+		updateCrc();
+		align();
+		const uint32_t crc = bits(16) | (bits(16) << 16);
+		const uint32_t size = bits(16) | (bits(16) << 16);
+		if (truncated()) error("unexpected end");
+		if (crc != crc_ || size != size_) error("bad crc");
+		state_ = stHeader;
+	}
+	void updateCrc()
+	{
+		crc_ = crc32(crc_, &out_[crcPos_], outEnd_ - crcPos_);
+		size_ += (uint32_t)(outEnd_ - crcPos_);
+		crcPos_ = outEnd_;
+	}
+	/* decode the next part of the stream into out_ */
+	void fill()
+	{
+		/* keep the window and the unread bytes */
+		const size_t keep = std::min(outPos_, outEnd_ > window ? outEnd_ - window : 0);
+		if (keep > 0) {
+			if (state_ != stHeader) updateCrc();
+			memmove(&out_[0], &out_[keep], outEnd_ - keep);
+			outPos_ -= keep;
+			outEnd_ -= keep;
+			crcPos_ -= std::min(crcPos_, keep);
+		}
+		const size_t limit = out_.size() - 258;
+		while (outEnd_ < limit && state_ != stEnd) {
+			switch (state_) {
+			case stHeader: readHeader(); break;
+			case stBlock: readBlock(); break;
+			case stStored: copyStored(limit); break;
+			case stHuffman: inflate(limit); break;
+			case stTrailer: readTrailer(); break;
+			default: break;
+			}
+		}
+	}
+public:
+	/**
+		@param bufSize [in] size of the buffers of input and output
+	*/
+	explicit Reader(const std::string& path, size_t bufSize = 1 << 20)
+		: fp_(fopen(path.c_str(), "rb"))
+		, path_(path)
+		, in_(bufSize)
+		, inPos_(0), inEnd_(0), inEof_(false)
+		, bits_(0), nbits_(0), padding_(0)
+		, out_(window * 2 + bufSize)
+		, outPos_(0), outEnd_(0), crcPos_(0), crc_(0), size_(0)
+		, state_(stHeader), last_(false), stored_(0), first_(true)
+	{
+		if (fp_ == 0) {
+			cybozu::Exception e("gzip");
+			e << "can't open" << path;
+			throw e;
+		}
+	}
+	~Reader() { fclose(fp_); }
+	/**
+		read up to n bytes
+		@return bytes read (less than n only at the end of stream)
+	*/
+	size_t read(char *buf, size_t n)
+	{
+		size_t done = 0;
+		while (done < n) {
+			if (outPos_ == outEnd_) {
+				if (state_ == stEnd) break;
+				fill();
+				continue;
+			}
+			const size_t m = std::min(n - done, outEnd_ - outPos_);
+			memcpy(buf + done, &out_[outPos_], m);
+			outPos_ += m;
+			done += m;
+		}
+		return done;
+	}
+	/**
+		append the whole rest of stream to out
+	*/
+	void readAll(std::string& out)
+	{
+		for (;;) {
+			if (outPos_ == outEnd_) {
+				if (state_ == stEnd) break;
+				fill();
+				continue;
+			}
+			out.append(&out_[outPos_], outEnd_ - outPos_);
+			outPos_ = outEnd_;
+		}
+	}
+};
+
+} // gzip
@@ -0,0 +1,446 @@
+/**
+	@file
+	@brief benchmark of the phases of maxsubst on generated corpora
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+
+#include <string>
+#include <vector>
+#include <random>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "maxsubst.hpp"
+#include "cybozu/exception.hpp"
+
+const size_t bytesPerChar = 24; // chars, SA, L, R, D and rank
+
+struct Options {
+	std::vector<size_t> sizes;
+	std::vector<std::string> samples;
+	std::string dir;
+	std::string csv;
+	std::string json;
+	int repeat;
+	int threads;
+	unsigned int seed;
+	Options() : dir("/tmp"), repeat(1), threads(1), seed(1)
+	{
+#ifdef _OPENMP
+		threads = omp_get_max_threads();
+#endif
+	}
+};
+
+void usage()
+{
+	std::cerr << "usage: maxbench [-s sizes] [-r sample file]... [-d work directory] [-n repeat] [-t threads] [--seed seed] [-o result.csv] [-j result.json]" << std::endl;
+	exit(1);
+}
+
+/*
+	10M => 10000000 (K, M, G)
+*/
+size_t parseSize(const std::string& s)
+{
+	char *end;
+	double v = strtod(s.c_str(), &end);
+	const std::string unit = end;
+	if (unit == "K" || unit == "k") {
+		v *= 1e3;
+	} else if (unit == "M" || unit == "m") {
+		v *= 1e6;
+	} else if (unit == "G" || unit == "g") {
+		v *= 1e9;
+	} else if (!unit.empty()) {
+		throw cybozu::Exception("maxbench") << "bad size" << s;
+	}
+	if (v < 1) throw cybozu::Exception("maxbench") << "bad size" << s;
+	return (size_t)v;
+}
+
+void parseOptions(Options& opt, int argc, char *argv[])
+{
+	std::string sizes = "10M,100M";
+	for (int i = 1; i < argc; i++) {
+		const std::string a = argv[i];
+		if (i + 1 < argc && a == "-s") {
+			sizes = argv[++i];
+		} else if (i + 1 < argc && a == "-r") {
+			opt.samples.push_back(argv[++i]);
+		} else if (i + 1 < argc && a == "-d") {
+			opt.dir = argv[++i];
+		} else if (i + 1 < argc && a == "-n") {
+			opt.repeat = std::max(1, atoi(argv[++i]));
+		} else if (i + 1 < argc && a == "-t") {
+			opt.threads = std::max(1, atoi(argv[++i]));
+		} else if (i + 1 < argc && a == "--seed") {
+			opt.seed = (unsigned int)strtoul(argv[++i], 0, 10);
+		} else if (i + 1 < argc && a == "-o") {
+			opt.csv = argv[++i];
+		} else if (i + 1 < argc && a == "-j") {
+			opt.json = argv[++i];
+		} else {
+			usage();
+		}
+	}
+	size_t pos = 0;
+	while (pos <= sizes.size()) {
+		size_t next = sizes.find(',', pos);
+		if (next == std::string::npos) next = sizes.size();
+		opt.sizes.push_back(parseSize(sizes.substr(pos, next - pos)));
+		pos = next + 1;
+	}
+}
+
+void appendUtf8(std::string& out, uint32_t c)
+{
+	if (c < 0x80) {
+		out += (char)c;
+	} else if (c < 0x800) {
+		out += (char)(0xc0 | (c >> 6));
+		out += (char)(0x80 | (c & 0x3f));
+	} else if (c < 0x10000) {
+		out += (char)(0xe0 | (c >> 12));
+		out += (char)(0x80 | ((c >> 6) & 0x3f));
+		out += (char)(0x80 | (c & 0x3f));
+	} else {
+		out += (char)(0xf0 | (c >> 18));
+		out += (char)(0x80 | ((c >> 12) & 0x3f));
+		out += (char)(0x80 | ((c >> 6) & 0x3f));
+		out += (char)(0x80 | (c & 0x3f));
+	}
+}
+
+/*
+	writer of a corpus by lines up to the number of characters
+*/
+class CorpusWriter {
+	FILE *fp_;
+	size_t chars_;
+	size_t bytes_;
+	CorpusWriter(const CorpusWriter&);
+	void operator=(const CorpusWriter&);
+public:
+	explicit CorpusWriter(const std::string& path)
+		: fp_(fopen(path.c_str(), "wb")), chars_(0), bytes_(0)
+	{
+		if (fp_ == 0) throw cybozu::Exception("maxbench") << "can't open" << path;
+	}
+	~CorpusWriter() { if (fp_) fclose(fp_); }
+	/*
+		@param line [in] UTF-8 with its newline
+		@param chars [in] number of characters of line
+	*/
+	void write(const std::string& line, size_t chars)
+	{
+		if (fwrite(line.data(), 1, line.size(), fp_) != line.size()) throw cybozu::Exception("maxbench") << "can't write corpus";
+		chars_ += chars;
+		bytes_ += line.size();
+	}
+	size_t chars() const { return chars_; }
+	size_t bytes() const { return bytes_; }
+};
+
+/*
+	lines of words drawn from a Zipf distribution over a vocabulary
+	of several scripts (Latin, accented Latin, Cyrillic, Greek, Hiragana, CJK
+	and a few characters out of BMP which maxsubst maps into a space)
+*/
+class Synthetic {
+	std::vector<std::string> words_;
+	std::vector<size_t> lengths_; //!< characters of each word
+	std::vector<double> cum_;     //!< cumulative distribution of words
+public:
+	explicit Synthetic(unsigned int seed, size_t vocabulary = 50000)
+	{
+		struct Script { uint32_t begin; uint32_t size; double weight; };
+		static const Script scripts[] = {
+			{ 0x61, 26, 50 },      // a-z
+			{ 0xe0, 32, 10 },      // accented Latin
+			{ 0x430, 32, 15 },     // Cyrillic
+			{ 0x3b1, 25, 5 },      // Greek
+			{ 0x3041, 86, 8 },     // Hiragana
+			{ 0x4e00, 3000, 10 },  // CJK
+			{ 0x1f600, 80, 2 },    // emoji
+		};
+		const size_t scriptN = sizeof(scripts) / sizeof(scripts[0]);
+		std::vector<double> weights;
+		for (size_t i = 0; i < scriptN; i++) weights.push_back(scripts[i].weight);
+		std::mt19937 rg(seed);
+		std::discrete_distribution<size_t> script(weights.begin(), weights.end());
+		std::geometric_distribution<size_t> length(0.25);
+		double sum = 0;
+		for (size_t i = 0; i < vocabulary; i++) {
+			const Script& s = scripts[script(rg)];
+			const size_t len = std::min<size_t>(1 + length(rg), s.begin >= 0x3041 && s.begin < 0x10000 ? 4 : 15);
+			std::string w;
+			for (size_t j = 0; j < len; j++) appendUtf8(w, s.begin + rg() % s.size);
+			words_.push_back(w);
+			lengths_.push_back(len);
+			sum += 1.0 / (i + 1);
+			cum_.push_back(sum);
+		}
+	}
+	void generate(CorpusWriter& out, size_t chars, unsigned int seed) const
+	{
+		std::mt19937 rg(seed);
+		std::uniform_real_distribution<double> u(0, cum_.back());
+		std::uniform_int_distribution<int> wordN(3, 25);
+		std::string line;
+		while (out.chars() < chars) {
+			line.clear();
+			size_t n = 0;
+			for (int i = wordN(rg); i > 0; i--) {
+				const size_t w = std::lower_bound(cum_.begin(), cum_.end(), u(rg)) - cum_.begin();
+				line += words_[w];
+				line += i > 1 ? ' ' : '\n';
+				n += lengths_[w] + 1;
+			}
+			out.write(line, n);
+		}
+	}
+};
+
+/*
+	lines drawn at random from real corpora
+*/
+class Sample {
+	std::vector<std::string> lines_;
+	std::vector<size_t> lengths_;
+public:
+	explicit Sample(const std::vector<std::string>& files)
+	{
+		for (size_t i = 0; i < files.size(); i++) {
+			std::ifstream ifs(files[i].c_str(), std::ios::binary);
+			if (!ifs) throw cybozu::Exception("maxbench") << "can't open" << files[i];
+			std::string line;
+			while (std::getline(ifs, line)) {
+				if (line.empty()) continue;
+				size_t n = 1;
+				for (size_t j = 0; j < line.size(); j++) {
+					if (((unsigned char)line[j] & 0xc0) != 0x80) n++;
+				}
+				lines_.push_back(line + '\n');
+				lengths_.push_back(n);
+			}
+		}
+		if (lines_.empty()) throw cybozu::Exception("maxbench") << "empty sample";
+	}
+	void generate(CorpusWriter& out, size_t chars, unsigned int seed) const
+	{
+		std::mt19937 rg(seed);
+		std::uniform_int_distribution<size_t> u(0, lines_.size() - 1);
+		while (out.chars() < chars) {
+			const size_t i = u(rg);
+			out.write(lines_[i], lengths_[i]);
+		}
+	}
+};
+
+/*
+	peak RSS (KB) since resetPeak
+	(VmHWM of Linux, which is reset by clear_refs, or ru_maxrss of the process)
+*/
+void resetPeak()
+{
+	FILE *fp = fopen("/proc/self/clear_refs", "w");
+	if (fp == 0) return;
+	fputs("5", fp);
+	fclose(fp);
+}
+
+long peakKb()
+{
+	FILE *fp = fopen("/proc/self/status", "r");
+	if (fp) {
+		char buf[256];
+		long kb = -1;
+		while (fgets(buf, sizeof(buf), fp)) {
+			if (sscanf(buf, "VmHWM: %ld", &kb) == 1) break;
+		}
+		fclose(fp);
+		if (kb >= 0) return kb;
+	}
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+struct Result {
+	std::string corpus;
+	size_t size;
+	int run;
+	size_t bytes;
+	size_t chars;
+	int nodes;
+	int maxsubst;
+	double sec[maxsubst::phaseN];
+	double total;
+	long peakKb;
+};
+
+class Timer {
+	std::chrono::steady_clock::time_point last_;
+	double *sec_;
+public:
+	explicit Timer(double *sec) : last_(std::chrono::steady_clock::now()), sec_(sec) { }
+	void lap(maxsubst::Phase phase)
+	{
+		const std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+		sec_[phase] = std::chrono::duration<double>(t - last_).count();
+		last_ = t;
+	}
+};
+
+/*
+	the same as maxsubst.cpp with a lap at the end of each phase
+*/
+void run(Result& res, const std::string& input, const std::string& output, int threads)
+{
+	resetPeak();
+	Timer timer(res.sec);
+	{
+		maxsubst::Corpus corpus;
+		if (!corpus.open(std::vector<const char*>(1, input.c_str()), threads)) throw cybozu::Exception("maxbench") << "can't open" << input;
+		timer.lap(maxsubst::phaseRead);
+
+		corpus.decode();
+		const std::vector<int>& charvec = corpus.chars;
+		const int n = (int)corpus.size();
+		res.chars = n;
+		timer.lap(maxsubst::phaseReplace);
+
+		std::vector<int> SA(n), L(n), R(n), D(n);
+		if (saisxx(charvec.begin(), SA.begin(), n, maxsubst::k) != 0) throw cybozu::Exception("maxbench") << "saisxx failed";
+		timer.lap(maxsubst::phaseSais);
+
+		esaxx_private::plcp_bounded(charvec.begin(), SA.begin(), L.begin(), R.begin(), n, maxsubst::sep);
+		timer.lap(maxsubst::phasePlcp);
+
+		res.nodes = esaxx_private::lcptree(SA.begin(), L.begin(), R.begin(), D.begin(), n);
+		timer.lap(maxsubst::phaseTree);
+
+		std::vector<int> rank;
+		maxsubst::rank(rank, SA, charvec);
+		timer.lap(maxsubst::phaseRank);
+
+		std::ofstream ofs(output.c_str(), std::ios::binary);
+		if (!ofs) throw cybozu::Exception("maxbench") << "can't open" << output;
+		res.maxsubst = maxsubst::write(ofs, corpus, SA, L, R, D, rank, res.nodes);
+		ofs.close();
+		timer.lap(maxsubst::phaseOutput);
+	}
+	res.peakKb = peakKb();
+	res.total = 0;
+	for (int i = 0; i < maxsubst::phaseN; i++) res.total += res.sec[i];
+}
+
+void writeCsv(std::ostream& os, const std::vector<Result>& results)
+{
+	os << "corpus,size,run,bytes,chars,nodes,maxsubst";
+	for (int i = 0; i < maxsubst::phaseN; i++) os << ',' << maxsubst::phaseName(i) << "_sec";
+	os << ",total_sec,peak_rss_kb\n";
+	char buf[64];
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		os << r.corpus << ',' << r.size << ',' << r.run << ',' << r.bytes << ',' << r.chars << ',' << r.nodes << ',' << r.maxsubst;
+		for (int j = 0; j < maxsubst::phaseN; j++) {
+			snprintf(buf, sizeof(buf), ",%.6f", r.sec[j]);
+			os << buf;
+		}
+		snprintf(buf, sizeof(buf), ",%.6f,%ld\n", r.total, r.peakKb);
+		os << buf;
+	}
+}
+
+void writeJson(std::ostream& os, const std::vector<Result>& results)
+{
+	char buf[64];
+	os << "[";
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		os << (i ? ",\n  {" : "\n  {") << "\"corpus\": \"" << r.corpus << "\", \"size\": " << r.size << ", \"run\": " << r.run
+			<< ", \"bytes\": " << r.bytes << ", \"chars\": " << r.chars << ", \"nodes\": " << r.nodes << ", \"maxsubst\": " << r.maxsubst
+			<< ", \"phases_sec\": {";
+		for (int j = 0; j < maxsubst::phaseN; j++) {
+			snprintf(buf, sizeof(buf), "%s\"%s\": %.6f", j ? ", " : "", maxsubst::phaseName(j), r.sec[j]);
+			os << buf;
+		}
+		snprintf(buf, sizeof(buf), "}, \"total_sec\": %.6f, \"peak_rss_kb\": %ld}", r.total, r.peakKb);
+		os << buf;
+	}
+	os << "\n]\n";
+}
+
+int main(int argc, char *argv[]) try
+{
+	Options opt;
+	parseOptions(opt, argc, argv);
+
+	Synthetic synthetic(opt.seed);
+	std::unique_ptr<Sample> sample;
+	if (!opt.samples.empty()) sample.reset(new Sample(opt.samples));
+
+	char suffix[64];
+	snprintf(suffix, sizeof(suffix), ".%d", (int)getpid());
+	const std::string input = opt.dir + "/maxbench.txt" + suffix;
+	const std::string output = opt.dir + "/maxbench.out" + suffix;
+	const double memory = (double)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+
+	std::vector<Result> results;
+	for (int c = 0; c < (sample ? 2 : 1); c++) {
+		const char *corpus = c == 0 ? "synthetic" : "sample";
+		for (size_t i = 0; i < opt.sizes.size(); i++) {
+			const size_t size = opt.sizes[i];
+			if (memory > 0 && (double)size * bytesPerChar > memory) {
+				std::cerr << corpus << ' ' << size << ": skipped (needs about " << (size * bytesPerChar >> 20) << "MB)" << std::endl;
+				continue;
+			}
+			Result res;
+			res.corpus = corpus;
+			res.size = size;
+			{
+				CorpusWriter out(input);
+				if (c == 0) {
+					synthetic.generate(out, size, opt.seed + (unsigned int)i);
+				} else {
+					sample->generate(out, size, opt.seed + (unsigned int)i);
+				}
+				res.bytes = out.bytes();
+			}
+			for (int r = 0; r < opt.repeat; r++) {
+				res.run = r;
+				run(res, input, output, opt.threads);
+				std::cerr << corpus << ' ' << size << " #" << r << ": " << res.total << " sec, " << res.peakKb << " KB" << std::endl;
+				results.push_back(res);
+			}
+			unlink(output.c_str());
+		}
+	}
+	unlink(input.c_str());
+
+	if (opt.csv.empty() && opt.json.empty()) writeCsv(std::cout, results);
+	if (!opt.csv.empty()) {
+		std::ofstream ofs(opt.csv.c_str());
+		if (!ofs) throw cybozu::Exception("maxbench") << "can't open" << opt.csv;
+		writeCsv(ofs, results);
+	}
+	if (!opt.json.empty()) {
+		std::ofstream ofs(opt.json.c_str());
+		if (!ofs) throw cybozu::Exception("maxbench") << "can't open" << opt.json;
+		writeJson(ofs, results);
+	}
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "ERR:" << e.what() << std::endl;
+	return 1;
+}
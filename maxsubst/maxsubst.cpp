@@ -1,64 +1,86 @@
-/**
-	@file
-	@brief maximal substring extractor
-
-	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
-*/
-
-#include <iostream>
-#include <vector>
-#include <fstream>
-#include "esa.hxx"
-#include "cybozu/string.hpp"
+/**
+	@file
+	@brief maximal substring extractor
 
-const int k = 0x10000;
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
 
-void replace(cybozu::String& str, const cybozu::String& from, cybozu::Char to) {
-    cybozu::String::size_type pos = 0;
-    while (pos = str.find(from, pos), pos != cybozu::String::npos) {
-		str[pos] = to;
-        ++pos;
-    }
-}
+#include <string>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "maxsubst.hpp"
 
 int main(int argc, char* argv[]){
-
-	std::ifstream ifs(argv[1], std::ios::binary);
-	cybozu::String str(std::istreambuf_iterator<char>(ifs.rdbuf()), std::istreambuf_iterator<char>());
-	//std::istreambuf_iterator<char> isit(std::cin);
-	//cybozu::String str(isit, std::istreambuf_iterator<char>());
-
-	replace(str, "\n", 1);	// replace \n => \u0001
-	replace(str, "\t", 32);	// replace \t => ' '
-	//replace(str, "\0", 32);	// replace \0 => ' '
-	size_t origLen = str.size();
+
+	std::string statsPath;
+	bool whole = false;
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	std::vector<const char*> args;
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 < argc && std::string(argv[i]) == "--stats") {
+			statsPath = argv[++i];
+		} else if (i + 1 < argc && std::string(argv[i]) == "-t") {
+			threads = std::max(1, atoi(argv[++i]));
+		} else if (std::string(argv[i]) == "--whole") {
+			whole = true;
+		} else {
+			args.push_back(argv[i]);
+		}
+	}
+	if (args.size() < 2) {
+		std::cerr << "usage: maxsubst [--stats stats.json] [-t threads] [--whole] [input files] [output file]" << std::endl;
+		return 1;
+	}
+	const char *output = args.back();
+	args.pop_back();
+	maxsubst::Stats stats;
+
+	maxsubst::Corpus corpus;
+	try {
+		if (!corpus.open(args, threads)) {
+			std::cerr << "can't open input files" << std::endl;
+			return 1;
+		}
+		stats.lap(maxsubst::phaseRead);
+		corpus.decode();
+	} catch (std::exception& e) {
+		std::cerr << "ERR:" << e.what() << std::endl;
+		return 1;
+	}
+	const std::vector<int>& charvec = corpus.chars;
+	size_t origLen = corpus.size();
 	std::cerr << "    chars:" << origLen << std::endl;
-
-	std::vector<int> charvec;
-	charvec.resize(origLen);
-	std::copy(str.begin(), str.end(), charvec.begin());
-	std::vector<int>::iterator icv = charvec.begin(), icvend=charvec.end();
-	for (;icv!=icvend;++icv) {
-		if (*icv == 0 || *icv >= k) *icv = 32;
-	}
+	stats.lap(maxsubst::phaseReplace);
 
 	std::vector<int> SA(origLen);
 	std::vector<int> L (origLen);
 	std::vector<int> R (origLen);
 	std::vector<int> D (origLen);
 
-	int nodeNum = 0;
-	if (esaxx(charvec.begin(), SA.begin(), L.begin(), R.begin(), D.begin(), (int)origLen, k, nodeNum) == -1){
+	/* esaxx() by phases */
+	int n = (int)origLen;
+	if (saisxx(charvec.begin(), SA.begin(), n, maxsubst::k, statsPath.empty() ? 0 : &stats.sais) != 0){
 		return -1;
 	}
+	stats.lap(maxsubst::phaseSais);
+	if (whole) {
+		esaxx_private::plcp(charvec.begin(), SA.begin(), L.begin(), R.begin(), n);
+	} else {
+		esaxx_private::plcp_bounded(charvec.begin(), SA.begin(), L.begin(), R.begin(), n, maxsubst::sep);
+	}
+	stats.lap(maxsubst::phasePlcp);
+	int nodeNum = esaxx_private::lcptree(SA.begin(), L.begin(), R.begin(), D.begin(), n);
 	std::cerr << "    nodes:" << nodeNum << std::endl;
+	stats.lap(maxsubst::phaseTree);
 
-	std::vector<int> rank(origLen);
-	int r = 0;
-	for (size_t i = 0; i < origLen; i++) {
-		if (i == 0 || charvec[(SA[i] + origLen - 1) % origLen] != charvec[(SA[i - 1] + origLen - 1) % origLen]) r++;
-		rank[i] = r;
-	}
+	std::vector<int> rank;
+	maxsubst::rank(rank, SA, charvec);
+	stats.lap(maxsubst::phaseRank);
 
 	/*
 	for (int i = 0; i < nodeNum; ++i){
@@ -68,16 +90,29 @@ int main(int argc, char* argv[]){
 	}
 	*/
 
-	std::ofstream ofs(argv[2], std::ios::binary);
-	int maxsubst = 0;
-	for (int i = 0; i < nodeNum; ++i){
-		int c = rank[ R[i] - 1 ] - rank[ L[i] ];
-		if (D[i] > 0 && c > 0) {
-			ofs << str.substr(SA[L[i]], D[i]) << "\t" << c + 1 << std::endl;
-			++maxsubst;
-		}
+	std::ofstream ofs(output, std::ios::binary);
+	int maxsubst = maxsubst::write(ofs, corpus, SA, L, R, D, rank, nodeNum, statsPath.empty() ? 0 : &stats);
+	ofs.close();
+	if (!ofs) {
+		std::cerr << "can't write " << output << std::endl;
+		return 1;
 	}
 	std::cerr << " maxsubst:" << maxsubst << std::endl;
+	stats.lap(maxsubst::phaseOutput);
+
+	if (!statsPath.empty()) {
+		stats.bytes = corpus.bytes;
+		stats.chars = (long long)origLen;
+		stats.countAlphabet(charvec);
+		stats.nodes = nodeNum;
+		stats.maxsubst = maxsubst;
+		std::ofstream sfs(statsPath.c_str());
+		if (!sfs) {
+			std::cerr << "can't open " << statsPath << std::endl;
+			return 1;
+		}
+		stats.writeJson(sfs);
+	}
 
 	return 0;
 }
@@ -0,0 +1,627 @@
+#pragma once
+/**
+	@file
+	@brief phases of maximal substring extraction
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MAXSUBST_SSE2
+#endif
+#include "esa.hxx"
+#include "gzip.hpp"
+#include "cybozu/string.hpp"
+#include "cybozu/itoa.hpp"
+
+namespace maxsubst {
+
+const int k = 0x10000;
+const int sep = 1; //!< line separator (\n) in the alphabet
+
+enum Phase {
+	phaseRead,     //!< map the files and count the characters of the chunks
+	phaseReplace,  //!< UTF-8 decode with the replacement and the mapping into the alphabet
+	phaseSais,     //!< suffix array (SA-IS)
+	phasePlcp,     //!< Psi and PLCP
+	phaseTree,     //!< internal nodes of suffix tree
+	phaseRank,
+	phaseOutput,
+	phaseN
+};
+
+inline const char *phaseName(int phase)
+{
+	static const char *tbl[] = { "read", "replace", "sais", "plcp", "suffixtree", "rank", "output" };
+	return tbl[phase];
+}
+
+inline double wallSec()
+{
+#ifdef _WIN32
+	LARGE_INTEGER t, f;
+	QueryPerformanceCounter(&t);
+	QueryPerformanceFrequency(&f);
+	return (double)t.QuadPart / f.QuadPart;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+#endif
+}
+
+/**
+	user + system time of the process
+*/
+inline double cpuSec()
+{
+#ifdef _WIN32
+	FILETIME c, e, k, u;
+	GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u);
+	return ((((unsigned long long)k.dwHighDateTime << 32) | k.dwLowDateTime) + (((unsigned long long)u.dwHighDateTime << 32) | u.dwLowDateTime)) * 1e-7;
+#else
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+#endif
+}
+
+/**
+	peak RSS of the process (KB, -1 if unknown)
+*/
+inline long peakKb()
+{
+#if defined(_WIN32)
+	return -1;
+#elif defined(__APPLE__)
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss / 1024;
+#else
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+#endif
+}
+
+/**
+	statistics of a run (--stats)
+	the histograms are of the maximal substrings in buckets of powers of 2
+	([1], [2, 3], [4, 7], ...)
+*/
+struct Stats {
+	static const int bucketN = 32;
+	long long bytes;
+	long long chars;
+	int alphabet;  //!< distinct characters after the mapping
+	saisxx_stats sais;
+	int nodes;
+	int maxsubst;
+	long long depth[bucketN]; //!< histogram of D (length)
+	long long count[bucketN]; //!< histogram of frequency
+	double wall[phaseN];
+	double cpu[phaseN];
+	double lastWall, lastCpu;
+	Stats()
+		: bytes(0), chars(0), alphabet(0), nodes(0), maxsubst(0)
+		, lastWall(wallSec()), lastCpu(cpuSec())
+	{
+		for (int i = 0; i < bucketN; i++) depth[i] = count[i] = 0;
+		for (int i = 0; i < phaseN; i++) wall[i] = cpu[i] = 0;
+	}
+	static int bucket(long long v)
+	{
+		int b = 0;
+		while (v > 1 && b < bucketN - 1) {
+			v >>= 1;
+			b++;
+		}
+		return b;
+	}
+	void lap(Phase phase)
+	{
+		const double w = wallSec(), c = cpuSec();
+		wall[phase] += w - lastWall;
+		cpu[phase] += c - lastCpu;
+		lastWall = w;
+		lastCpu = c;
+	}
+	void countAlphabet(const std::vector<int>& charvec)
+	{
+		std::vector<bool> used(k);
+		for (size_t i = 0; i < charvec.size(); i++) used[charvec[i]] = true;
+		alphabet = (int)std::count(used.begin(), used.end(), true);
+	}
+	void put(std::ostream& os, const char *name, const long long *hist) const
+	{
+		int n = bucketN;
+		while (n > 0 && hist[n - 1] == 0) n--;
+		os << "  \"" << name << "\": [";
+		for (int i = 0; i < n; i++) {
+			os << (i ? ", " : "") << "{\"from\": " << (1LL << i) << ", \"to\": " << ((1LL << (i + 1)) - 1) << ", \"n\": " << hist[i] << "}";
+		}
+		os << "],\n";
+	}
+	void writeJson(std::ostream& os) const
+	{
+		char buf[128];
+		os << "{\n  \"input_bytes\": " << bytes << ",\n  \"chars\": " << chars
+			<< ",\n  \"alphabet\": " << alphabet << ",\n  \"sais\": {\"depth\": " << sais.levels << ", \"levels\": [";
+		for (int i = 0; i < sais.levels; i++) {
+			os << (i ? ", " : "") << "{\"n\": " << sais.n[i] << ", \"k\": " << sais.k[i]
+				<< ", \"reduced_n\": " << sais.m[i] << ", \"reduced_k\": " << sais.names[i] << "}";
+		}
+		os << "]},\n  \"nodes\": " << nodes << ",\n  \"maxsubst\": " << maxsubst << ",\n";
+		put(os, "depth_histogram", depth);
+		put(os, "count_histogram", count);
+		os << "  \"phases\": {";
+		double w = 0, c = 0;
+		for (int i = 0; i < phaseN; i++) {
+			snprintf(buf, sizeof(buf), "%s\n    \"%s\": {\"wall_sec\": %.6f, \"cpu_sec\": %.6f}", i ? "," : "", phaseName(i), wall[i], cpu[i]);
+			os << buf;
+			w += wall[i];
+			c += cpu[i];
+		}
+		snprintf(buf, sizeof(buf), "\n  },\n  \"wall_sec\": %.6f,\n  \"cpu_sec\": %.6f,\n  \"peak_rss_kb\": %ld\n}\n", w, c, peakKb());
+		os << buf;
+	}
+};
+
+/**
+	read-only memory mapped file
+	(a gzip file is decompressed on memory)
+*/
+class MappedFile {
+	const char *p_;
+	size_t size_;
+	std::string inflated_;
+#ifdef _WIN32
+	std::vector<char> buf_;
+#endif
+	MappedFile(const MappedFile&);
+	void operator=(const MappedFile&);
+public:
+	MappedFile() : p_(0), size_(0) { }
+	~MappedFile() { close(); }
+	/**
+		@return false if the file can't be opened
+	*/
+	bool open(const char *file)
+	{
+		close();
+		if (gzip::isGzip(file)) {
+			gzip::Reader reader(file);
+			reader.readAll(inflated_);
+			p_ = inflated_.data();
+			size_ = inflated_.size();
+			return true;
+		}
+#ifdef _WIN32
+		std::ifstream ifs(file, std::ios::binary);
+		if (!ifs) return false;
+		buf_.assign(std::istreambuf_iterator<char>(ifs.rdbuf()), std::istreambuf_iterator<char>());
+		p_ = buf_.empty() ? 0 : &buf_[0];
+		size_ = buf_.size();
+#else
+		int fd = ::open(file, O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			::close(fd);
+			return false;
+		}
+		size_ = st.st_size;
+		if (size_ > 0) {
+			void *p = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED) {
+				::close(fd);
+				size_ = 0;
+				return false;
+			}
+			p_ = (const char *)p;
+		}
+		::close(fd);
+#endif
+		return true;
+	}
+	void close()
+	{
+#ifdef _WIN32
+		buf_.clear();
+#else
+		if (p_ && p_ != inflated_.data()) munmap((void *)p_, size_);
+#endif
+		std::string().swap(inflated_);
+		p_ = 0;
+		size_ = 0;
+	}
+	const char *data() const { return p_; }
+	size_t size() const { return size_; }
+};
+
+/**
+	map a character into the alphabet of size k
+	(\n => \u0001, \t => ' ', and 0 and out of BMP => ' ')
+	@param mapped [out] (pos, c) if c is mapped to ' '
+*/
+inline int mapChar(int c, int pos, std::vector<std::pair<int, int> >& mapped)
+{
+	if (c == '\n') return 1;
+	if (c == '\t') return 32;
+	if (c == 0 || c >= k) {
+		mapped.push_back(std::make_pair(pos, c));
+		return 32;
+	}
+	return c;
+}
+
+namespace local {
+
+inline bool in(unsigned int c, unsigned int lo, unsigned int hi) { return c - lo <= hi - lo; }
+
+/**
+	decode a non-ASCII character (the same validation as cybozu::string::GetCharFromUtf8)
+	@param p [in, out] begin, which is moved to the next character if valid
+	@return character or -1 if not UTF-8
+*/
+inline int decodeMultibyte(const unsigned char *&p, const unsigned char *end)
+{
+	const unsigned int c0 = p[0];
+	if (in(c0, 0xc2, 0xdf)) {
+		if (end - p < 2 || !in(p[1], 0x80, 0xbf)) return -1;
+		const int c = ((c0 & 0x1f) << 6) | (p[1] & 0x3f);
+		p += 2;
+		return c;
+	}
+	if (in(c0, 0xe0, 0xef)) {
+		if (end - p < 3) return -1;
+		const unsigned int c1 = p[1], c2 = p[2];
+		if (!in(c2, 0x80, 0xbf)) return -1;
+		if (c0 == 0xe0 ? !in(c1, 0xa0, 0xbf) : c0 == 0xed ? !in(c1, 0x80, 0x9f) : !in(c1, 0x80, 0xbf)) return -1;
+		p += 3;
+		return ((c0 & 0x0f) << 12) | ((c1 & 0x3f) << 6) | (c2 & 0x3f);
+	}
+	if (in(c0, 0xf0, 0xf4)) {
+		if (end - p < 4) return -1;
+		const unsigned int c1 = p[1], c2 = p[2], c3 = p[3];
+		if (!in(c2, 0x80, 0xbf) || !in(c3, 0x80, 0xbf)) return -1;
+		if (c0 == 0xf0 ? !in(c1, 0x90, 0xbf) : c0 == 0xf4 ? !in(c1, 0x80, 0x8f) : !in(c1, 0x80, 0xbf)) return -1;
+		p += 4;
+		return ((c0 & 0x07) << 18) | ((c1 & 0x3f) << 12) | ((c2 & 0x3f) << 6) | (c3 & 0x3f);
+	}
+	return -1;
+}
+
+#ifdef MAXSUBST_SSE2
+/**
+	map 16 ASCII bytes without NUL (\n => 1, \t => ' ') and store them as int
+*/
+inline void storeAscii(int *out, __m128i v)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+	const __m128i tab = _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'));
+	v = _mm_or_si128(_mm_andnot_si128(_mm_or_si128(nl, tab), v),
+		_mm_or_si128(_mm_and_si128(nl, _mm_set1_epi8(1)), _mm_and_si128(tab, _mm_set1_epi8(32))));
+	const __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+	_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16(lo, zero));
+	_mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi16(lo, zero));
+	_mm_storeu_si128((__m128i*)(out + 8), _mm_unpacklo_epi16(hi, zero));
+	_mm_storeu_si128((__m128i*)(out + 12), _mm_unpackhi_epi16(hi, zero));
+}
+#endif
+
+} // local
+
+/**
+	decode UTF-8 [p, end) into the alphabet
+	blocks of 64 ASCII bytes (without NUL) are mapped and widened by SSE2,
+	and the others are decoded one by one
+	@param out [out] characters (mapChar)
+	@param mapped [out] original characters mapped to ' '
+	@param pos [in] position of out[0] in the corpus
+	@param p [in, out] begin, which is set to the broken character if false
+	@return false if [p, end) is not UTF-8
+*/
+inline bool decode(int *&out, std::vector<std::pair<int, int> >& mapped, int pos, const char *&p, const char *end)
+{
+	int *const begin = out;
+	const unsigned char *q = (const unsigned char *)p, *const qend = (const unsigned char *)end;
+	while (q < qend) {
+#ifdef MAXSUBST_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		while (qend - q >= 64) {
+			const __m128i v0 = _mm_loadu_si128((const __m128i*)q);
+			const __m128i v1 = _mm_loadu_si128((const __m128i*)(q + 16));
+			const __m128i v2 = _mm_loadu_si128((const __m128i*)(q + 32));
+			const __m128i v3 = _mm_loadu_si128((const __m128i*)(q + 48));
+			const __m128i high = _mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3));
+			const __m128i nul = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v0, zero), _mm_cmpeq_epi8(v1, zero)),
+				_mm_or_si128(_mm_cmpeq_epi8(v2, zero), _mm_cmpeq_epi8(v3, zero)));
+			if (_mm_movemask_epi8(_mm_or_si128(high, nul))) break;
+			local::storeAscii(out, v0);
+			local::storeAscii(out + 16, v1);
+			local::storeAscii(out + 32, v2);
+			local::storeAscii(out + 48, v3);
+			q += 64;
+			out += 64;
+		}
+		/* the block which has non-ASCII or NUL, and the rest under 64 bytes */
+		const unsigned char *const blockEnd = qend - q > 64 ? q + 64 : qend;
+#else
+		const unsigned char *const blockEnd = qend;
+#endif
+		while (q < blockEnd) {
+			int c = *q;
+			if (c < 0x80) {
+				q++;
+			} else if ((c = local::decodeMultibyte(q, qend)) < 0) {
+				p = (const char *)q;
+				return false;
+			}
+			*out = mapChar(c, pos + (int)(out - begin), mapped);
+			out++;
+		}
+	}
+	p = end;
+	return true;
+}
+
+/**
+	number of the characters of UTF-8 [p, end) (the bytes except for the continuation bytes)
+*/
+inline size_t countChars(const char *p, const char *end)
+{
+	size_t n = 0;
+#ifdef MAXSUBST_SSE2
+	/* continuation bytes are [-128, -65] as signed char */
+	const __m128i lead = _mm_set1_epi8(-65);
+	while (end - p >= 16) {
+		__m128i sum = _mm_setzero_si128();
+		for (int i = 0; i < 255 && end - p >= 16; i++) {
+			sum = _mm_sub_epi8(sum, _mm_cmpgt_epi8(_mm_loadu_si128((const __m128i*)p), lead));
+			p += 16;
+		}
+		sum = _mm_sad_epu8(sum, _mm_setzero_si128());
+		n += _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+	}
+#endif
+	for (; p < end; p++) n += ((unsigned char)*p & 0xc0) != 0x80;
+	return n;
+}
+
+/**
+	input files decoded into the alphabet (input of esaxx)
+	the files are concatenated, and \u0001 is put between them if a file doesn't end with \n,
+	so a line never continues into the next file
+*/
+class Corpus {
+	struct Chunk {
+		int file;
+		const char *begin;
+		const char *end;
+		bool sep;   //!< followed by \u0001
+		size_t pos; //!< of the first character in chars
+		std::vector<std::pair<int, int> > mapped;
+		const char *broken; //!< broken UTF-8 or 0
+	};
+	std::vector<const char*> files_;
+	std::vector<MappedFile*> maps_;
+	std::vector<Chunk> chunks_;
+	int threads_;
+	Corpus(const Corpus&);
+	void operator=(const Corpus&);
+	void close()
+	{
+		for (size_t i = 0; i < maps_.size(); i++) delete maps_[i];
+		maps_.clear();
+		chunks_.clear();
+	}
+public:
+	std::vector<int> chars;
+	std::vector<std::pair<int, int> > mapped; //!< (pos, original character) of 0 and out of BMP (sorted)
+	long long bytes;
+	static const size_t minChunk = 1 << 20;
+
+	Corpus() : threads_(1), bytes(0) { }
+	~Corpus() { close(); }
+	/**
+		map the files, divide them into chunks of lines and count the characters of the chunks
+		@param threads [in] threads of counting and decoding (with OpenMP)
+		@return false if a file can't be opened
+	*/
+	bool open(const std::vector<const char*>& files, int threads = 1)
+	{
+		close();
+		files_ = files;
+		threads_ = std::max(threads, 1);
+		bytes = 0;
+		const int fileN = (int)files.size();
+		for (int i = 0; i < fileN; i++) maps_.push_back(new MappedFile());
+		/* gzip files are decompressed in parallel */
+		std::vector<int> opened(fileN);
+		std::vector<std::string> errors(fileN);
+#ifdef _OPENMP
+		#pragma omp parallel for num_threads(threads_) schedule(dynamic)
+#endif
+		for (int i = 0; i < fileN; i++) {
+			try {
+				opened[i] = maps_[i]->open(files[i]);
+			} catch (std::exception& e) {
+				errors[i] = e.what();
+			}
+		}
+		for (int i = 0; i < fileN; i++) {
+			if (!errors[i].empty()) throw cybozu::Exception("maxsubst") << errors[i];
+			if (!opened[i]) return false;
+			bytes += maps_[i]->size();
+		}
+		const size_t chunkSize = std::max<size_t>(minChunk, (size_t)(bytes / (threads_ * 4)) + 1);
+		for (size_t i = 0; i < maps_.size(); i++) {
+			const char *p = maps_[i]->data(), *const end = p + maps_[i]->size();
+			while (p < end) {
+				const char *q = end;
+				if ((size_t)(end - p) > chunkSize) {
+					q = (const char *)memchr(p + chunkSize, '\n', end - p - chunkSize);
+					q = q ? q + 1 : end;
+				}
+				chunks_.push_back(Chunk());
+				Chunk& c = chunks_.back();
+				c.file = (int)i;
+				c.begin = p;
+				c.end = q;
+				c.sep = q == end && end[-1] != '\n' && i + 1 < maps_.size();
+				c.pos = 0;
+				c.broken = 0;
+				p = q;
+			}
+		}
+		const int n = (int)chunks_.size();
+#ifdef _OPENMP
+		#pragma omp parallel for num_threads(threads_) schedule(dynamic)
+#endif
+		for (int i = 0; i < n; i++) {
+			chunks_[i].pos = countChars(chunks_[i].begin, chunks_[i].end) + chunks_[i].sep;
+		}
+		size_t total = 0;
+		for (int i = 0; i < n; i++) {
+			const size_t len = chunks_[i].pos;
+			chunks_[i].pos = total;
+			total += len;
+		}
+		if (total >= (size_t)INT_MAX) throw cybozu::Exception("maxsubst") << "too large corpus" << (uint64_t)total;
+		chars.resize(total);
+		return true;
+	}
+	/**
+		decode the chunks into chars in parallel and unmap the files
+	*/
+	void decode()
+	{
+		const int n = (int)chunks_.size();
+#ifdef _OPENMP
+		#pragma omp parallel for num_threads(threads_) schedule(dynamic)
+#endif
+		for (int i = 0; i < n; i++) {
+			Chunk& c = chunks_[i];
+			int *out = &chars[0] + c.pos;
+			const char *p = c.begin;
+			if (!maxsubst::decode(out, c.mapped, (int)c.pos, p, c.end)) {
+				c.broken = p;
+				continue;
+			}
+			if (c.sep) *out = 1;
+		}
+		mapped.clear();
+		for (int i = 0; i < n; i++) {
+			const Chunk& c = chunks_[i];
+			if (c.broken) throw cybozu::Exception("maxsubst") << "bad UTF-8" << files_[c.file] << (uint64_t)(c.broken - maps_[c.file]->data());
+			mapped.insert(mapped.end(), c.mapped.begin(), c.mapped.end());
+		}
+		close();
+	}
+	size_t size() const { return chars.size(); }
+	/**
+		append the original characters of [pos, pos + n) as UTF-8
+	*/
+	void appendUtf8(std::string& out, int pos, int n) const
+	{
+		std::vector<std::pair<int, int> >::const_iterator m = std::lower_bound(mapped.begin(), mapped.end(), std::make_pair(pos, 0));
+		for (int i = pos; i < pos + n; i++) {
+			int c = chars[i];
+			if (m != mapped.end() && m->first == i) {
+				c = m->second;
+				++m;
+			}
+			cybozu::string::AppendUtf8(out, c);
+		}
+	}
+};
+
+/**
+	rank of the previous characters of the suffixes
+	(rank[R - 1] - rank[L] > 0 iff a node is left-branching)
+*/
+inline void rank(std::vector<int>& rank, const std::vector<int>& SA, const std::vector<int>& charvec)
+{
+	const size_t n = charvec.size();
+	rank.resize(n);
+	int r = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (i == 0 || charvec[(SA[i] + n - 1) % n] != charvec[(SA[i - 1] + n - 1) % n]) r++;
+		rank[i] = r;
+	}
+}
+
+/**
+	whether the occurrences of the node are followed by different characters
+	(or the end of the corpus)
+*/
+inline bool isRightBranching(const std::vector<int>& chars, const std::vector<int>& SA, int L, int R, int D)
+{
+	const int n = (int)chars.size();
+	const int c = SA[L] + D < n ? chars[SA[L] + D] : -1;
+	for (int j = L + 1; j < R; j++) {
+		if ((SA[j] + D < n ? chars[SA[j] + D] : -1) != c) return true;
+	}
+	return c < 0;
+}
+
+/**
+	write maximal substrings and their frequencies
+	the lines are encoded into a buffer which is written by blocks of 1MB
+	a node which ends with sep (the bound of plcp_bounded) is written only if it is right-branching
+	without the bound, so the substrings are the same as of the whole corpus except the ones spanning sep
+	@param stats [out] histograms if not 0
+	@return number of maximal substrings
+*/
+inline int write(std::ostream& os, const Corpus& corpus, const std::vector<int>& SA, const std::vector<int>& L,
+	const std::vector<int>& R, const std::vector<int>& D, const std::vector<int>& rank, int nodeNum, Stats *stats = 0)
+{
+	const size_t bufSize = 1 << 20;
+	int maxsubst = 0;
+	std::string buf, num;
+	buf.reserve(bufSize * 2);
+	for (int i = 0; i < nodeNum; ++i){
+		int c = rank[ R[i] - 1 ] - rank[ L[i] ];
+		if (D[i] > 0 && c > 0) {
+			if (D[i] > 1 && corpus.chars[SA[L[i]] + D[i] - 1] == sep && !isRightBranching(corpus.chars, SA, L[i], R[i], D[i])) continue;
+			corpus.appendUtf8(buf, SA[L[i]], D[i]);
+			cybozu::itoa(num, c + 1);
+			buf += '\t';
+			buf += num;
+			buf += '\n';
+			if (buf.size() >= bufSize) {
+				os.write(buf.data(), buf.size());
+				buf.clear();
+			}
+			++maxsubst;
+			if (stats) {
+				stats->depth[Stats::bucket(D[i])]++;
+				stats->count[Stats::bucket(c + 1)]++;
+			}
+		}
+	}
+	os.write(buf.data(), buf.size());
+	return maxsubst;
+}
+
+} // maxsubst
@@ -39,6 +39,17 @@
 # include <omp.h>
 #endif
 
+/* sizes of the problems at each level of the recursion */
+struct saisxx_stats {
+  enum { maxLevels = 64 };
+  int levels;
+  long long n[maxLevels];     /* length */
+  long long k[maxLevels];     /* alphabet size */
+  long long m[maxLevels];     /* LMS-substrings (length of the reduced problem) */
+  long long names[maxLevels]; /* distinct LMS-substrings (alphabet size of the reduced problem) */
+  saisxx_stats() : levels(0) { }
+};
+
 namespace saisxx_private {
 
 /* find the start or end of each bucket */
@@ -161,7 +172,7 @@ template<typename string_type, typename sarray_type, typename index_type>
 int
 suffixsort(string_type T, sarray_type SA,
            index_type fs, index_type n, index_type k,
-           bool isbwt) {
+           bool isbwt, saisxx_stats *stats = 0) {
 typedef typename std::iterator_traits<string_type>::value_type char_type;
   sarray_type RA;
   index_type i, j, m, p, q, plen, qlen, name, pidx = 0;
@@ -249,6 +260,11 @@ typedef typename std::iterator_traits<string_type>::value_type char_type;
     SA[m + (p >> 1)] = name;
   }
 
+  if((stats != 0) && (stats->levels < saisxx_stats::maxLevels)) {
+    int l = stats->levels++;
+    stats->n[l] = n, stats->k[l] = k, stats->m[l] = m, stats->names[l] = name;
+  }
+
   /* stage 2: solve the reduced problem
      recurse if names are not yet unique */
   if(name < m) {
@@ -256,7 +272,7 @@ typedef typename std::iterator_traits<string_type>::value_type char_type;
     for(i = m + (n >> 1) - 1, j = m - 1; m <= i; --i) {
       if(SA[i] != 0) { RA[j--] = SA[i] - 1; }
     }
-    if(suffixsort(RA, SA, fs + n - m * 2, m, name, false) != 0) { return -2; }
+    if(suffixsort(RA, SA, fs + n - m * 2, m, name, false, stats) != 0) { return -2; }
     for(i = n - 2, j = m - 1, c = 0, c1 = T[n - 1]; 0 <= i; --i, c1 = c0) {
       if((c0 = T[i]) < (c1 + c)) { c = 1; }
       else if(c != 0) { RA[j--] = i + 1, c = 0; } /* get p1 */
@@ -318,15 +334,16 @@ typedef typename std::iterator_traits<string_type>::value_type char_type;
  * @param SA[0..n-1] The output array of suffixes. (random access iterator)
  * @param n The length of the given string.
  * @param k The alphabet size.
+ * @param stats The output sizes of the recursion if not 0.
  * @return 0 if no error occurred, -1 or -2 otherwise.
  */
 template<typename string_type, typename sarray_type, typename index_type>
 int
-saisxx(string_type T, sarray_type SA, index_type n, index_type k = 256) {
+saisxx(string_type T, sarray_type SA, index_type n, index_type k = 256, saisxx_stats *stats = 0) {
   int err;
   if((n < 0) || (k <= 0)) { return -1; }
   if(n <= 1) { if(n == 1) { SA[0] = 0; } return 0; }
-  try { err = saisxx_private::suffixsort(T, SA, 0, n, k, false); }
+  try { err = saisxx_private::suffixsort(T, SA, 0, n, k, false, stats); }
   catch(...) { err = -2; }
   return err;
 }
@@ -0,0 +1,144 @@
+#pragma once
+/**
+	@file
+	@brief cache of detection results keyed by normalized text
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include "cybozu/string.hpp"
+
+namespace ldig {
+
+/**
+	64bit hash of normalized text
+*/
+inline uint64_t hashText(const cybozu::String& s)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ s.size();
+	for (size_t i = 0; i < s.size(); i++) {
+		h = (h ^ s[i]) * 0xff51afd7ed558ccdULL;
+		h ^= h >> 32;
+	}
+	return h;
+}
+
+/**
+	bounded cache of probabilities (K doubles) for the hash of normalized text
+	the entries are divided into shards by hash, each shard has its own lock
+	and evicts with CLOCK (second chance).
+	@note the text itself is not kept, so different texts with the same 64bit hash share the result
+*/
+class ResultCache {
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<uint64_t, uint32_t> index; //!< key -> slot
+		std::vector<uint64_t> keys;
+		std::vector<double> values;   //!< slot * K
+		std::vector<char> referenced;
+		size_t used;
+		size_t hand;
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		Shard() : used(0), hand(0), hits(0), misses(0), evictions(0) { }
+	};
+	static const size_t shardBits = 6;
+	std::vector<Shard> shards_;
+	size_t K_;
+	size_t capacity_; //!< per shard
+	ResultCache(const ResultCache&);
+	void operator=(const ResultCache&);
+
+	Shard& shard(uint64_t key) { return shards_[key >> (64 - shardBits)]; }
+public:
+	struct Stats {
+		uint64_t capacity;
+		uint64_t size;
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		double hitRate() const { return hits + misses > 0 ? (double)hits / (hits + misses) : 0; }
+	};
+
+	/**
+		@param capacity [in] max number of entries (rounded up to multiple of shards)
+		@param K [in] number of labels
+	*/
+	ResultCache(size_t capacity, size_t K)
+		: shards_(size_t(1) << shardBits), K_(K)
+		, capacity_(std::max<size_t>(1, (capacity + shards_.size() - 1) / shards_.size()))
+	{
+		for (size_t i = 0; i < shards_.size(); i++) {
+			Shard& s = shards_[i];
+			s.index.reserve(capacity_);
+			s.keys.resize(capacity_);
+			s.values.resize(capacity_ * K_);
+			s.referenced.resize(capacity_);
+		}
+	}
+	/**
+		get cached probabilities
+		@param y [out] K probabilities if found
+	*/
+	bool get(uint64_t key, double *y)
+	{
+		Shard& s = shard(key);
+		std::lock_guard<std::mutex> lock(s.mutex);
+		std::unordered_map<uint64_t, uint32_t>::const_iterator i = s.index.find(key);
+		if (i == s.index.end()) {
+			s.misses++;
+			return false;
+		}
+		s.hits++;
+		s.referenced[i->second] = 1;
+		std::copy(&s.values[i->second * K_], &s.values[i->second * K_] + K_, y);
+		return true;
+	}
+	void put(uint64_t key, const double *y)
+	{
+		Shard& s = shard(key);
+		std::lock_guard<std::mutex> lock(s.mutex);
+		std::unordered_map<uint64_t, uint32_t>::const_iterator i = s.index.find(key);
+		size_t slot;
+		if (i != s.index.end()) {
+			slot = i->second;
+		} else {
+			if (s.used < capacity_) {
+				slot = s.used++;
+			} else {
+				/* second chance for the referenced entries */
+				while (s.referenced[s.hand]) {
+					s.referenced[s.hand] = 0;
+					s.hand = (s.hand + 1) % capacity_;
+				}
+				slot = s.hand;
+				s.hand = (s.hand + 1) % capacity_;
+				s.index.erase(s.keys[slot]);
+				s.evictions++;
+			}
+			s.keys[slot] = key;
+			s.referenced[slot] = 0;
+			s.index[key] = (uint32_t)slot;
+		}
+		std::copy(y, y + K_, &s.values[slot * K_]);
+	}
+	void getStats(Stats& stats)
+	{
+		stats.capacity = capacity_ * shards_.size();
+		stats.size = stats.hits = stats.misses = stats.evictions = 0;
+		for (size_t i = 0; i < shards_.size(); i++) {
+			Shard& s = shards_[i];
+			std::lock_guard<std::mutex> lock(s.mutex);
+			stats.size += s.used;
+			stats.hits += s.hits;
+			stats.misses += s.misses;
+			stats.evictions += s.evictions;
+		}
+	}
+};
+
+} // ldig
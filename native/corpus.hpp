@@ -0,0 +1,427 @@
+#pragma once
+/**
+	@file
+	@brief labeled corpus reader and featurized corpus cache
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include <vector>
+#include <list>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "normalize.hpp"
+#include "model.hpp"
+#include "mmap.hpp"
+#include "queue.hpp"
+#include "../maxsubst/gzip.hpp"
+
+namespace ldig {
+
+/**
+	read lines with large buffer (a gzip file is decompressed)
+*/
+class LineReader {
+	FILE *fp_;
+	std::unique_ptr<gzip::Reader> gz_;
+	std::vector<char> buf_;
+	size_t pos_;
+	size_t end_;
+	bool eof_;
+	bool newline_;
+	LineReader(const LineReader&);
+	void operator=(const LineReader&);
+public:
+	explicit LineReader(const std::string& path, size_t bufSize = 1 << 20)
+		: fp_(0)
+		, buf_(bufSize)
+		, pos_(0)
+		, end_(0)
+		, eof_(false)
+		, newline_(false)
+	{
+		if (path != "-" && gzip::isGzip(path)) {
+			gz_.reset(new gzip::Reader(path));
+			return;
+		}
+		fp_ = path == "-" ? stdin : fopen(path.c_str(), "rb");
+		if (fp_ == 0) {
+			cybozu::Exception e("corpus");
+			e << "can't open" << path;
+			throw e;
+		}
+	}
+	~LineReader()
+	{
+		if (fp_ && fp_ != stdin) fclose(fp_);
+	}
+	/**
+		get one line without '\n'
+		@return false if end of file
+	*/
+	bool getline(std::string& line)
+	{
+		line.clear();
+		newline_ = false;
+		for (;;) {
+			if (pos_ == end_) {
+				if (eof_) return !line.empty();
+				end_ = gz_ ? gz_->read(&buf_[0], buf_.size()) : fread(&buf_[0], 1, buf_.size(), fp_);
+				pos_ = 0;
+				if (end_ < buf_.size()) eof_ = true;
+				if (end_ == 0) return !line.empty();
+			}
+			const char *p = &buf_[pos_];
+			const char *q = (const char *)memchr(p, '\n', end_ - pos_);
+			if (q) {
+				line.append(p, q);
+				pos_ += q - p + 1;
+				newline_ = true;
+				return true;
+			}
+			line.append(p, end_ - pos_);
+			pos_ = end_;
+		}
+	}
+	/**
+		the last line ended with '\n' (false only for the last line of file)
+	*/
+	bool hasNewline() const { return newline_; }
+};
+
+namespace corpus_local {
+
+struct Header {
+	char magic[8];
+	uint64_t modelHash;
+	uint64_t sourceSize;
+	int64_t sourceMtime; //!< nanoseconds
+	uint64_t sourceIno;
+	uint64_t n; //!< number of texts
+	uint64_t nEvents;
+};
+
+const char magic[8] = { 'L', 'D', 'I', 'G', 'F', 'C', '0', '2' };
+
+/* size, modification time (nanoseconds) and inode of the corpus file to validate its cache */
+inline void getFileStat(const std::string& path, Header& header)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		cybozu::Exception e("corpus");
+		e << "can't stat" << path;
+		throw e;
+	}
+	header.sourceSize = st.st_size;
+#if defined(_WIN32)
+	header.sourceMtime = (int64_t)st.st_mtime * 1000000000;
+#elif defined(__APPLE__)
+	header.sourceMtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	header.sourceMtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+	header.sourceIno = st.st_ino;
+}
+
+/* absolute path without symbolic links (path itself if it fails) */
+inline std::string canonicalPath(const std::string& path)
+{
+#ifdef _WIN32
+	char buf[_MAX_PATH];
+	return _fullpath(buf, path.c_str(), sizeof(buf)) ? std::string(buf) : path;
+#else
+	char *p = realpath(path.c_str(), 0);
+	if (p == 0) return path;
+	const std::string ret = p;
+	free(p);
+	return ret;
+#endif
+}
+
+inline std::string baseName(const std::string& path)
+{
+	size_t p = path.find_last_of("/\\");
+	return p == std::string::npos ? path : path.substr(p + 1);
+}
+
+/*
+	[model dir]/[file name].[hash of the canonical path].fc,
+	so the files of the same name in the different directories have their own caches
+*/
+inline std::string cachePath(const std::string& dir, const std::string& file)
+{
+	const std::string path = canonicalPath(file);
+	char hash[32];
+	snprintf(hash, sizeof(hash), ".%016llx.fc", (unsigned long long)model_local::fnv1a(path.data(), path.size()));
+	return dir + "/" + baseName(file) + hash;
+}
+
+} // corpus_local
+
+/**
+	texts of corpus as (label, features).
+	each corpus file is normalized and featurized once into [model dir]/[file name].[hash of path].fc
+	and the file is mapped on memory at the later runs.
+	the cache is rebuilt when the trie, the labels or the corpus file (its size, mtime in nanoseconds or inode)
+	is changed.
+
+	format of .fc (little endian)
+	- Header
+	- uint64_t offsets[n + 1] : events of i-th text are events[offsets[i], offsets[i + 1])
+	- int32_t labels[n] (padded to 8 bytes) : -1 for unknown label
+	- Event events[nEvents]
+*/
+class FeaturizedCorpus {
+	std::vector<MappedFile*> maps_;
+	std::list<std::string> images_;
+	std::vector<int> labels_;
+	std::vector<const Event*> events_;
+	std::vector<int> lengths_;
+	std::vector<std::pair<std::string, size_t> > files_; //!< (file, first index)
+
+	FeaturizedCorpus(const FeaturizedCorpus&);
+	void operator=(const FeaturizedCorpus&);
+
+	/* set up index of image, false if image is not valid for header */
+	bool attach(const char *p, size_t size, const corpus_local::Header& header)
+	{
+		using namespace corpus_local;
+		if (size < sizeof(Header)) return false;
+		const Header *h = (const Header *)p;
+		if (memcmp(h->magic, magic, sizeof(magic)) != 0 || h->modelHash != header.modelHash
+			|| h->sourceSize != header.sourceSize || h->sourceMtime != header.sourceMtime
+			|| h->sourceIno != header.sourceIno) return false;
+		const size_t n = h->n;
+		const size_t labelsSize = (n * sizeof(int32_t) + 7) & ~size_t(7);
+		if (size != sizeof(Header) + (n + 1) * sizeof(uint64_t) + labelsSize + h->nEvents * sizeof(Event)) return false;
+		const uint64_t *offsets = (const uint64_t *)(p + sizeof(Header));
+		const int32_t *labels = (const int32_t *)(offsets + n + 1);
+		const Event *events = (const Event *)((const char *)labels + labelsSize);
+		for (size_t i = 0; i < n; i++) {
+			labels_.push_back(labels[i]);
+			events_.push_back(events + offsets[i]);
+			lengths_.push_back((int)(offsets[i + 1] - offsets[i]));
+		}
+		return true;
+	}
+	/* normalized and featurized texts of a part of file */
+	struct Part {
+		std::vector<int32_t> labels;
+		std::vector<uint64_t> ends;
+		Events events;
+	};
+	static void featurize(Part *part, const char *p, const char *end, const Model *model)
+	{
+		Events events;
+		std::vector<int> work;
+		std::string line, label, org;
+		cybozu::String text, buf;
+		while (p < end) {
+			const char *q = (const char *)memchr(p, '\n', end - p);
+			if (q == 0) q = end;
+			line.assign(p, q);
+			p = q + 1;
+			normalizeText(label, text, org, line);
+			model->extract(events, work, buf, text);
+			part->labels.push_back(model->labelIndex(label));
+			part->events.insert(part->events.end(), events.begin(), events.end());
+			part->ends.push_back(part->events.size());
+		}
+	}
+	/* lines of a gzip file and their texts */
+	struct Block {
+		std::string lines;
+		Part part;
+	};
+	static const size_t blockSize = 4 << 20;
+	static void featurizeBlocks(BoundedQueue<Block*> *queue, const Model *model)
+	{
+		for (;;) {
+			Block *b = queue->pop();
+			if (b == 0) return;
+			featurize(&b->part, b->lines.data(), b->lines.data() + b->lines.size(), model);
+			std::string().swap(b->lines);
+		}
+	}
+	/*
+		normalize and featurize texts in gzip file:
+		this thread decompresses the file into blocks of lines and the threads featurize them,
+		so the decompression overlaps the featurization and the file is never expanded on disk
+	*/
+	static void featurizeGzip(std::vector<std::unique_ptr<Block> >& blocks, const std::string& file, const Model& model, int threads)
+	{
+		BoundedQueue<Block*> queue(threads * 2);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) workers.push_back(std::thread(featurizeBlocks, &queue, &model));
+		try {
+			gzip::Reader reader(file);
+			std::vector<char> buf(blockSize);
+			std::string rest; // the last line of the previous block without '\n'
+			for (;;) {
+				const size_t n = reader.read(&buf[0], buf.size());
+				const bool eof = n < buf.size();
+				std::unique_ptr<Block> b(new Block);
+				b->lines.swap(rest);
+				b->lines.append(&buf[0], n);
+				if (!eof) {
+					const size_t q = b->lines.rfind('\n');
+					if (q == std::string::npos) {
+						rest.swap(b->lines);
+						continue;
+					}
+					rest.assign(b->lines, q + 1, std::string::npos);
+					b->lines.resize(q + 1);
+				}
+				if (!b->lines.empty()) {
+					blocks.push_back(std::move(b));
+					queue.push(blocks.back().get());
+				}
+				if (eof) break;
+			}
+		} catch (...) {
+			for (int t = 0; t < threads; t++) queue.push(0);
+			for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+			throw;
+		}
+		for (int t = 0; t < threads; t++) queue.push(0);
+		for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+	}
+	/* normalize and featurize texts in file with threads */
+	static void build(std::string& image, const std::string& file, const Model& model, const corpus_local::Header& header, int threads)
+	{
+		using namespace corpus_local;
+		MappedFile map;
+		std::string input;
+		std::vector<Part> parts;
+		std::vector<std::unique_ptr<Block> > blocks;
+		std::vector<const Part*> ordered;
+		if (file != "-" && gzip::isGzip(file)) {
+			featurizeGzip(blocks, file, model, threads);
+			for (size_t i = 0; i < blocks.size(); i++) ordered.push_back(&blocks[i]->part);
+		} else {
+			const char *top, *end;
+			if (file == "-") {
+				LineReader reader(file);
+				std::string line;
+				while (reader.getline(line)) {
+					input += line;
+					input += '\n';
+				}
+				top = input.data();
+				end = top + input.size();
+			} else {
+				if (!map.open(file)) {
+					cybozu::Exception e("corpus");
+					e << "can't open" << file;
+					throw e;
+				}
+				top = map.data();
+				end = top + map.size();
+			}
+			/* split at line boundaries */
+			std::vector<const char *> bounds(1, top);
+			for (int t = 1; t < threads; t++) {
+				const char *p = std::max(bounds.back(), top + (end - top) * t / threads);
+				const char *q = p < end ? (const char *)memchr(p, '\n', end - p) : 0;
+				bounds.push_back(q ? q + 1 : end);
+			}
+			bounds.push_back(end);
+			parts.resize(threads);
+			std::vector<std::thread> workers;
+			for (int t = 1; t < threads; t++) {
+				workers.push_back(std::thread(featurize, &parts[t], bounds[t], bounds[t + 1], &model));
+			}
+			featurize(&parts[0], bounds[0], bounds[1], &model);
+			for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+			for (int t = 0; t < threads; t++) ordered.push_back(&parts[t]);
+		}
+
+		std::vector<uint64_t> offsets(1, 0);
+		std::vector<int32_t> labels;
+		Events all;
+		for (size_t t = 0; t < ordered.size(); t++) {
+			const Part& part = *ordered[t];
+			for (size_t i = 0; i < part.ends.size(); i++) offsets.push_back(all.size() + part.ends[i]);
+			labels.insert(labels.end(), part.labels.begin(), part.labels.end());
+			all.insert(all.end(), part.events.begin(), part.events.end());
+		}
+		Header h = header;
+		h.n = labels.size();
+		h.nEvents = all.size();
+		labels.resize((labels.size() + 1) & ~size_t(1), -1);
+		image.clear();
+		image.append((const char *)&h, sizeof(h));
+		image.append((const char *)&offsets[0], offsets.size() * sizeof(uint64_t));
+		if (!labels.empty()) image.append((const char *)&labels[0], labels.size() * sizeof(int32_t));
+		if (!all.empty()) image.append((const char *)&all[0], all.size() * sizeof(Event));
+	}
+public:
+	FeaturizedCorpus() { }
+	~FeaturizedCorpus()
+	{
+		for (size_t i = 0; i < maps_.size(); i++) delete maps_[i];
+	}
+	/**
+		add corpus file
+		@param file [in] corpus file
+		@param model [in] model (the cache is stored in its directory)
+		@param useCache [in] use and make .fc cache
+		@param threads [in] number of threads to featurize texts
+	*/
+	void add(const std::string& file, const Model& model, bool useCache = true, int threads = 1)
+	{
+		using namespace corpus_local;
+		files_.push_back(std::make_pair(file, labels_.size()));
+		Header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, magic, sizeof(magic));
+		header.modelHash = model.trieHash;
+		if (file == "-") useCache = false;
+		std::string cache;
+		if (useCache) {
+			getFileStat(file, header);
+			cache = cachePath(model.dir(), file);
+			MappedFile *m = new MappedFile;
+			if (m->open(cache) && attach(m->data(), m->size(), header)) {
+				maps_.push_back(m);
+				return;
+			}
+			delete m;
+		}
+		images_.push_back(std::string());
+		std::string& image = images_.back();
+		build(image, file, model, header, threads);
+		if (useCache) {
+			const std::string temp = cache + ".temp";
+			FILE *fp = fopen(temp.c_str(), "wb");
+			if (fp) {
+				const bool ok = fwrite(image.data(), 1, image.size(), fp) == image.size();
+				if (fclose(fp) == 0 && ok) rename(temp.c_str(), cache.c_str());
+			}
+		}
+		attach(image.data(), image.size(), header);
+	}
+	size_t size() const { return labels_.size(); }
+	/**
+		@return index of label, -1 if unknown
+	*/
+	int label(size_t i) const { return labels_[i]; }
+	const Event *events(size_t i) const { return events_[i]; }
+	size_t length(size_t i) const { return lengths_[i]; }
+	/**
+		get file name and line number of i-th text
+	*/
+	void getLocation(std::string& file, size_t& line, size_t i) const
+	{
+		size_t j = files_.size() - 1;
+		while (files_[j].second > i) j--;
+		file = files_[j].first;
+		line = i - files_[j].second + 1;
+	}
+};
+
+} // ldig
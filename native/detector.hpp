@@ -0,0 +1,322 @@
+#pragma once
+/**
+	@file
+	@brief language detection with the JSON response of server.py
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <stdio.h>
+#include "normalize.hpp"
+#include "model.hpp"
+#include "cache.hpp"
+#include "earlyexit.hpp"
+#include "subset.hpp"
+#include "session.hpp"
+#include "segment.hpp"
+#include "metrics.hpp"
+#include "profile.hpp"
+#include "json.hpp"
+
+namespace ldig {
+
+/**
+	detector of server.py
+	features are escaped into JSON at loading, so detect() only concatenates them.
+*/
+class Detector {
+	const Model& model_;
+	std::vector<std::string> featureJson_; //!< JSON string of each feature
+	std::string labelsJson_;
+	std::vector<std::string> labelJson_; //!< JSON string of each label
+	std::vector<int> rank_; //!< order of each feature by string (empty if features file is sorted)
+	ResultCache *cache_;
+	const EarlyExit *early_;
+	Segmenter segmenter_;
+	/* index of i-th label of subset (or all labels) */
+	static int labelAt(const LabelSubset *subset, size_t i) { return subset ? subset->labels()[i] : (int)i; }
+
+	struct ByRank {
+		const std::vector<int>& rank;
+		explicit ByRank(const std::vector<int>& rank) : rank(rank) { }
+		bool operator()(const Event& a, const Event& b) const { return rank[a.id] < rank[b.id]; }
+	};
+	struct ByString {
+		const std::vector<std::string>& features;
+		explicit ByString(const std::vector<std::string>& features) : features(features) { }
+		bool operator()(int a, int b) const { return features[a] < features[b]; }
+	};
+public:
+	/**
+		work area of a thread
+	*/
+	struct Work {
+		std::string label;
+		std::string org;
+		cybozu::String text;
+		cybozu::String buf;
+		std::vector<int> ids;
+		Events events;
+		std::vector<double> y;
+		std::vector<double> rest;
+		std::vector<double> z;
+		Segmenter::Work seg;
+		std::vector<Segment> segs;
+		StageTimes times; //!< of the last detection
+		WalkProfile *profile; //!< of the feature extraction if not 0
+		Work() : profile(0) { }
+	};
+
+	explicit Detector(const Model& model)
+		: model_(model), cache_(0), early_(0), segmenter_(model)
+	{
+		std::string buf;
+		readFile(buf, model.featuresPath());
+		std::vector<std::string> features;
+		features.reserve(model.M);
+		for (size_t p = 0; p < buf.size(); ) {
+			size_t q = buf.find('\n', p);
+			if (q == std::string::npos) q = buf.size();
+			const size_t tab = buf.rfind('\t', q);
+			if (tab == std::string::npos || tab <= p) {
+				cybozu::Exception e("detector");
+				e << "irregular feature" << features.size() + 1;
+				throw e;
+			}
+			features.push_back(buf.substr(p, tab - p));
+			p = q + 1;
+		}
+		if (features.size() != model.M) {
+			cybozu::Exception e("detector");
+			e << "features doesn't match parameters" << features.size() << model.M;
+			throw e;
+		}
+		featureJson_.resize(features.size());
+		bool sorted = true;
+		for (size_t i = 0; i < features.size(); i++) {
+			appendJsonString(featureJson_[i], features[i]);
+			if (i > 0 && !(features[i - 1] < features[i])) sorted = false;
+		}
+		/* UTF-8 byte order is the same as code point order */
+		if (!sorted) {
+			std::vector<int> order(features.size());
+			for (size_t i = 0; i < order.size(); i++) order[i] = (int)i;
+			std::sort(order.begin(), order.end(), ByString(features));
+			rank_.resize(order.size());
+			for (size_t i = 0; i < order.size(); i++) rank_[order[i]] = (int)i;
+		}
+		labelJson_.resize(model.K);
+		labelsJson_ = "[";
+		for (size_t k = 0; k < model.K; k++) {
+			appendJsonString(labelJson_[k], model.labels[k]);
+			if (k > 0) labelsJson_ += ", ";
+			labelsJson_ += labelJson_[k];
+		}
+		labelsJson_ += "]";
+	}
+	const Model& model() const { return model_; }
+	const std::string& labelJson(size_t k) const { return labelJson_[k]; }
+	/**
+		cache the probabilities of normalized texts (0 to disable)
+	*/
+	void setCache(ResultCache *cache) { cache_ = cache; }
+	/**
+		stop scanning texts when the label is decided (0 to scan the whole texts)
+	*/
+	void setEarlyExit(const EarlyExit *early) { early_ = early; }
+
+	/**
+		subset of labels for the comma separated names
+		(only the labels, the parameters are read from the model)
+		@return empty if names are empty or all labels
+	*/
+	std::shared_ptr<const LabelSubset> subset(const std::string& names) const
+	{
+		std::vector<int> labels;
+		for (size_t p = 0; p <= names.size(); ) {
+			size_t q = names.find(',', p);
+			if (q == std::string::npos) q = names.size();
+			const std::string name = names.substr(p, q - p);
+			p = q + 1;
+			if (name.empty()) continue;
+			const int k = model_.labelIndex(name);
+			if (k < 0) {
+				cybozu::Exception e("detector");
+				e << "unknown label" << name;
+				throw e;
+			}
+			labels.push_back(k);
+		}
+		std::sort(labels.begin(), labels.end());
+		labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+		if (labels.empty() || labels.size() == model_.K) return std::shared_ptr<const LabelSubset>();
+		return std::shared_ptr<const LabelSubset>(new LabelSubset(model_, labels));
+	}
+
+	/**
+		probabilities of labels for st
+		@param w [out] w.y are the probabilities and w.events are the features
+		(w.events is empty if the probabilities are cached or scanned with early exit,
+		and w.profile counts only the texts whose features are extracted)
+		@param needEvents [in] don't use the cache nor the early exit
+		@param subset [in] softmax of the labels only (the others have 0)
+		@return index of the most probable label
+	*/
+	size_t predict(Work& w, const std::string& st, bool needEvents = false, const LabelSubset *subset = 0) const
+	{
+		w.times.start();
+		normalizeText(w.label, w.text, w.org, st, false);
+		w.times.lap(stageNormalize);
+		w.y.resize(model_.K);
+		const uint64_t key = cache_ && !subset ? hashText(w.text) : 0;
+		if (subset) {
+			extract(w);
+			w.times.lap(stageExtract);
+			w.z.resize(subset->size());
+			subset->predict(&w.z[0], w.events);
+			std::fill(w.y.begin(), w.y.end(), 0.0);
+			for (size_t s = 0; s < subset->size(); s++) w.y[subset->labels()[s]] = w.z[s];
+		} else if (cache_ && !needEvents && cache_->get(key, &w.y[0])) {
+			w.events.clear();
+		} else if (early_ && !needEvents) {
+			w.events.clear();
+			early_->predict(&w.y[0], w.rest, w.buf, w.text);
+			if (cache_) cache_->put(key, &w.y[0]);
+		} else {
+			extract(w);
+			w.times.lap(stageExtract);
+			model_.predict(&w.y[0], w.events);
+			if (cache_) cache_->put(key, &w.y[0]);
+		}
+		/* extraction with early exit and cache lookup are in score */
+		w.times.lap(stageScore);
+		return std::max_element(w.y.begin(), w.y.end()) - w.y.begin();
+	}
+
+	/**
+		detect language of st (same as server.Detector.detect)
+		@param json [out] {"label": top label, "labels": [...], "prob": [...]}
+		and "data": [{"id", "feature", "phi"}...] if explain
+		("labels", "prob" and "phi" are of the labels in subset if given)
+		@note data are sorted by feature, i.e. by id if features file is sorted
+	*/
+	void detect(std::string& json, Work& w, const std::string& st, bool explain = false, const LabelSubset *subset = 0) const
+	{
+		const size_t top = predict(w, st, explain, subset);
+		toJson(json, w, top, explain, subset);
+	}
+	/**
+		detect language of st continuing from the last text of session
+		(the same JSON as detect())
+	*/
+	void detect(std::string& json, Work& w, Session& session, const std::string& st, bool explain = false) const
+	{
+		w.times.start();
+		normalizeText(w.label, w.text, w.org, st, false);
+		w.times.lap(stageNormalize);
+		w.y.resize(model_.K);
+		session.update(w.text);
+		w.times.lap(stageExtract);
+		session.predict(&w.y[0], explain ? &w.events : 0);
+		w.times.lap(stageScore);
+		const size_t top = std::max_element(w.y.begin(), w.y.end()) - w.y.begin();
+		toJson(json, w, top, explain, 0);
+	}
+	/**
+		spans of languages in st
+		@param json [out] {"label": label of the whole, "prob": its probability,
+		"segments": [{"begin", "end", "text", "label", "prob"}...]}
+		where begin and end are the positions in the normalized text
+	*/
+	void segment(std::string& json, Work& w, const std::string& st, double penalty = Segmenter::defaultPenalty()) const
+	{
+		const size_t K = model_.K;
+		w.times.start();
+		normalizeText(w.label, w.text, w.org, st, false);
+		w.times.lap(stageNormalize);
+		segmenter_.segment(w.segs, w.seg, w.text, penalty);
+		/* the whole is the sum of the spans (including the boundary marks) */
+		const std::vector<double>& cum = w.seg.cum;
+		w.y.assign(cum.end() - K, cum.end());
+		Model::softmax(&w.y[0], K);
+		const size_t top = std::max_element(w.y.begin(), w.y.end()) - w.y.begin();
+		w.times.lap(stageScore);
+
+		char buf[64];
+		json = "{\"label\": ";
+		json += labelJson_[top];
+		snprintf(buf, sizeof(buf), ", \"prob\": %0.3f, \"segments\": [", w.y[top]);
+		json += buf;
+		for (size_t i = 0; i < w.segs.size(); i++) {
+			const Segment& seg = w.segs[i];
+			snprintf(buf, sizeof(buf), "%s{\"begin\": %d, \"end\": %d, \"text\": ", i ? ", " : "", (int)seg.begin, (int)seg.end);
+			json += buf;
+			appendJsonString(json, cybozu::String(w.text.begin() + seg.begin, w.text.begin() + seg.end));
+			json += ", \"label\": ";
+			json += labelJson_[seg.label];
+			snprintf(buf, sizeof(buf), ", \"prob\": %0.3f}", seg.y[seg.label]);
+			json += buf;
+		}
+		json += "]}";
+		w.times.lap(stageSerialize);
+	}
+private:
+	void extract(Work& w) const
+	{
+		if (w.profile) {
+			model_.extract(w.events, w.ids, w.buf, w.text, *w.profile);
+			w.profile->endText(w.events);
+		} else {
+			model_.extract(w.events, w.ids, w.buf, w.text);
+		}
+	}
+	void toJson(std::string& json, Work& w, size_t top, bool explain, const LabelSubset *subset) const
+	{
+		const size_t K = model_.K;
+		const size_t n = subset ? subset->size() : K;
+		char buf[32];
+		json = "{\"label\": ";
+		json += labelJson_[top];
+		json += ", \"labels\": ";
+		if (subset) {
+			json += '[';
+			for (size_t i = 0; i < n; i++) {
+				if (i > 0) json += ", ";
+				json += labelJson_[labelAt(subset, i)];
+			}
+			json += ']';
+		} else {
+			json += labelsJson_;
+		}
+		if (explain) {
+			if (!rank_.empty()) std::sort(w.events.begin(), w.events.end(), ByRank(rank_));
+			json += ", \"data\": [";
+			for (size_t i = 0; i < w.events.size(); i++) {
+				const int id = w.events[i].id;
+				snprintf(buf, sizeof(buf), "%s{\"id\": %d, \"feature\": ", i ? ", " : "", id);
+				json += buf;
+				json += featureJson_[id];
+				json += ", \"phi\": [";
+				const double *phi = &model_.param[id * K];
+				for (size_t i = 0; i < n; i++) {
+					snprintf(buf, sizeof(buf), "%s\"%0.3f\"", i ? ", " : "", phi[labelAt(subset, i)]);
+					json += buf;
+				}
+				json += "]}";
+			}
+			json += "]";
+		}
+		json += ", \"prob\": [";
+		for (size_t i = 0; i < n; i++) {
+			snprintf(buf, sizeof(buf), "%s\"%0.3f\"", i ? ", " : "", w.y[labelAt(subset, i)]);
+			json += buf;
+		}
+		json += "]}";
+		w.times.lap(stageSerialize);
+	}
+};
+
+} // ldig
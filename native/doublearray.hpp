@@ -0,0 +1,129 @@
+#pragma once
+/**
+	@file
+	@brief read-only Double Array (doublearray.npz generated by da.py)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <vector>
+#include <algorithm>
+#include "npy.hpp"
+
+namespace ldig {
+
+/**
+	feature id and its frequency in a text
+*/
+struct Event {
+	int id;
+	int count;
+};
+typedef std::vector<Event> Events;
+
+class DoubleArray {
+	std::vector<int> base_;
+	std::vector<int> check_;
+	std::vector<int> value_;
+	int N_;
+public:
+	DoubleArray() : N_(0) { }
+
+	void load(const std::string& path)
+	{
+		std::map<std::string, npy::Array> arrays;
+		npy::loadNpz(arrays, path);
+		arrays["base"].get(base_);
+		arrays["check"].get(check_);
+		arrays["value"].get(value_);
+		N_ = (int)base_.size();
+		if (check_.size() != base_.size() || value_.size() != base_.size()) {
+			cybozu::Exception e("doublearray");
+			e << "broken" << path;
+			throw e;
+		}
+	}
+	int size() const { return N_; }
+
+	/**
+		move to the child of pointer by c
+		@return child node or -1
+	*/
+	int child(int pointer, int c) const
+	{
+		const int next = base_[pointer] + c;
+		if ((unsigned int)next >= (unsigned int)N_ || check_[next] != pointer) return -1;
+		return next;
+	}
+	int value(int pointer) const { return value_[pointer]; }
+	/**
+		@return parent node or -1 (root and unused nodes)
+	*/
+	int parent(int pointer) const { return pointer == 0 ? -1 : check_[pointer]; }
+
+	/**
+		walker which does nothing
+	*/
+	struct NoWalk {
+		void operator()(size_t) const { }
+	};
+	/**
+		append all ids of features in s[0, n) (same as da.DoubleArray.extract_features)
+		@param ids [out] ids of features (not unique)
+		@param walk [in] walk(transitions) for the walk from each position
+	*/
+	template<class C, class W>
+	void extractIds(std::vector<int>& ids, const C *s, size_t n, W& walk) const
+	{
+		const int *base = &base_[0];
+		const int *check = &check_[0];
+		const int *value = &value_[0];
+		const unsigned int N = N_;
+		for (size_t i = 0; i < n; i++) {
+			int pointer = 0;
+			size_t j = i;
+			for (; j < n; j++) {
+				const int next = base[pointer] + (int)s[j];
+				if ((unsigned int)next >= N || check[next] != pointer) break;
+				const int id = value[next];
+				if (id >= 0) ids.push_back(id);
+				pointer = next;
+			}
+			walk(j - i);
+		}
+	}
+	template<class C>
+	void extractIds(std::vector<int>& ids, const C *s, size_t n) const
+	{
+		NoWalk walk;
+		extractIds(ids, s, n, walk);
+	}
+
+	/**
+		get features in s[0, n) with frequencies
+		@param events [out] (id, frequency) sorted by id
+		@param ids [local] work area
+	*/
+	template<class C, class W>
+	void extractFeatures(Events& events, std::vector<int>& ids, const C *s, size_t n, W& walk) const
+	{
+		ids.clear();
+		extractIds(ids, s, n, walk);
+		std::sort(ids.begin(), ids.end());
+		events.clear();
+		for (size_t i = 0; i < ids.size(); ) {
+			size_t j = i + 1;
+			while (j < ids.size() && ids[j] == ids[i]) j++;
+			const Event e = { ids[i], (int)(j - i) };
+			events.push_back(e);
+			i = j;
+		}
+	}
+	template<class C>
+	void extractFeatures(Events& events, std::vector<int>& ids, const C *s, size_t n) const
+	{
+		NoWalk walk;
+		extractFeatures(events, ids, s, n, walk);
+	}
+};
+
+} // ldig
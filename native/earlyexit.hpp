@@ -0,0 +1,147 @@
+#pragma once
+/**
+	@file
+	@brief scoring which stops when the detected label is decided
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "model.hpp"
+
+namespace ldig {
+
+/**
+	A feature changes the difference of the scores of two labels
+	by its weight spread (max - min of the weights) at most.
+	bound(node) of the trie is the largest total spread of the features
+	on a path from the node, so the features starting at a position
+	of the text can change the differences by bound(root -> first char) at most.
+	The scan of the text stops when the scores of the rest can't move
+	the top label below the threshold, i.e. the label of ldig.likelihood is decided.
+	The probabilities are those of the scanned part of the text.
+*/
+class EarlyExit {
+	const Model& model_;
+	std::vector<double> bound_; //!< for each node of trie
+	double threshold_;
+	EarlyExit(const EarlyExit&);
+	void operator=(const EarlyExit&);
+public:
+	/**
+		@param threshold [in] probability to accept the top label (ldig.likelihood uses 0.6)
+	*/
+	explicit EarlyExit(const Model& model, double threshold = 0.6)
+		: model_(model), threshold_(threshold)
+	{
+		const DoubleArray& trie = model.trie;
+		const int N = trie.size();
+		const size_t K = model.K;
+		/* children of each node (CSR) */
+		std::vector<int> begin(N + 1), children(N);
+		for (int i = 0; i < N; i++) {
+			const int p = trie.parent(i);
+			if (p >= 0) begin[p + 1]++;
+		}
+		for (int i = 0; i < N; i++) begin[i + 1] += begin[i];
+		std::vector<int> pos(begin.begin(), begin.end() - 1);
+		for (int i = 0; i < N; i++) {
+			const int p = trie.parent(i);
+			if (p >= 0) children[pos[p]++] = i;
+		}
+		/* children come after their parent in BFS order, so reverse it */
+		std::vector<int> order;
+		order.reserve(N);
+		order.push_back(0);
+		for (size_t i = 0; i < order.size(); i++) {
+			const int v = order[i];
+			order.insert(order.end(), &children[0] + begin[v], &children[0] + begin[v + 1]);
+		}
+		bound_.assign(N, 0);
+		std::vector<double> maxChild(N, 0);
+		for (size_t i = order.size(); i > 0; i--) {
+			const int v = order[i - 1];
+			double spread = 0;
+			const int id = trie.value(v);
+			if (id >= 0 && (size_t)id < model.M) {
+				const double *w = &model.param[id * K];
+				spread = *std::max_element(w, w + K) - *std::min_element(w, w + K);
+			}
+			bound_[v] = spread + maxChild[v];
+			const int p = trie.parent(v);
+			if (p >= 0) maxChild[p] = std::max(maxChild[p], bound_[v]);
+		}
+	}
+	double threshold() const { return threshold_; }
+
+	/**
+		probabilities of s[0, n) (with the boundary marks) scanning it until the label is decided
+		@param y [out] K probabilities
+		@param rest [local] work area
+		@return number of scanned positions (n if not decided)
+	*/
+	template<class C>
+	size_t predict(double *y, std::vector<double>& rest, const C *s, size_t n) const
+	{
+		const DoubleArray& trie = model_.trie;
+		const size_t K = model_.K;
+		const double *param = &model_.param[0];
+		/* rest[i] : bound of the changes by the features starting at i or later */
+		rest.resize(n + 1);
+		rest[n] = 0;
+		for (size_t i = n; i > 0; i--) {
+			const int c = trie.child(0, (int)s[i - 1]);
+			rest[i - 1] = rest[i] + (c >= 0 ? bound_[c] : 0);
+		}
+		for (size_t k = 0; k < K; k++) y[k] = 0;
+		size_t i = 0;
+		while (i < n) {
+			int pointer = 0;
+			for (size_t j = i; j < n; j++) {
+				pointer = trie.child(pointer, (int)s[j]);
+				if (pointer < 0) break;
+				const int id = trie.value(pointer);
+				if (id < 0) continue;
+				const double *w = param + id * K;
+				for (size_t k = 0; k < K; k++) y[k] += w[k];
+			}
+			i++;
+			if (i < n && decided(y, rest[i])) break;
+		}
+		softmax(y);
+		return i;
+	}
+	/**
+		probabilities of normalized text (same as Model::extract and Model::predict)
+		@param buf [local] work area
+	*/
+	size_t predict(double *y, std::vector<double>& rest, cybozu::String& buf, const cybozu::String& text) const
+	{
+		buf.clear();
+		buf.push_back(1);
+		buf += text;
+		buf.push_back(1);
+		return predict(y, rest, buf.data(), buf.size());
+	}
+private:
+	/*
+		the top label keeps the probability >= threshold
+		even if the scores of all the others gain r against it
+	*/
+	bool decided(const double *z, double r) const
+	{
+		const size_t K = model_.K;
+		size_t top = 0;
+		for (size_t k = 1; k < K; k++) if (z[top] < z[k]) top = k;
+		double second = -HUGE_VAL;
+		for (size_t k = 0; k < K; k++) if (k != top && second < z[k]) second = z[k];
+		if (z[top] - second <= r) return false;
+		double sum = 0;
+		for (size_t k = 0; k < K; k++) if (k != top) sum += std::exp(z[k] - z[top] + r);
+		return 1 / (1 + sum) >= threshold_;
+	}
+	void softmax(double *y) const { Model::softmax(y, model_.K); }
+};
+
+} // ldig
@@ -0,0 +1,823 @@
+#pragma once
+/**
+	@file
+	@brief small HTTP/1.1 server with epoll event loops (Linux only)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <algorithm>
+#include <unordered_set>
+#include <atomic>
+#include <memory>
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "cybozu/exception.hpp"
+
+#ifndef EPOLLEXCLUSIVE
+	#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+namespace ldig {
+
+namespace http {
+
+struct Exception : cybozu::Exception {
+	Exception() : cybozu::Exception("http") { }
+};
+
+/* decode %XX and '+' (same as urllib.unquote_plus) */
+inline std::string unquote(const std::string& s, size_t begin = 0, size_t end = std::string::npos)
+{
+	if (end > s.size()) end = s.size();
+	std::string out;
+	out.reserve(end - begin);
+	for (size_t i = begin; i < end; i++) {
+		const char c = s[i];
+		if (c == '+') {
+			out += ' ';
+		} else if (c == '%' && i + 2 < end && isxdigit((unsigned char)s[i + 1]) && isxdigit((unsigned char)s[i + 2])) {
+			out += (char)strtol(s.substr(i + 1, 2).c_str(), 0, 16);
+			i += 2;
+		} else {
+			out += c;
+		}
+	}
+	return out;
+}
+
+typedef std::multimap<std::string, std::string> Params;
+
+/* parse query string (same as urlparse.parse_qs, blank values are dropped) */
+inline void parseQuery(Params& params, const std::string& query)
+{
+	params.clear();
+	size_t p = 0;
+	while (p <= query.size()) {
+		size_t q = query.find_first_of("&;", p);
+		if (q == std::string::npos) q = query.size();
+		const size_t eq = query.find('=', p);
+		if (eq < q && eq + 1 < q) {
+			params.insert(std::make_pair(unquote(query, p, eq), unquote(query, eq + 1, q)));
+		}
+		p = q + 1;
+	}
+}
+
+struct Request {
+	std::string method;
+	std::string path;  //!< without query
+	std::string query;
+	std::string version;
+	std::vector<std::pair<std::string, std::string> > headers; //!< names are lower case
+	std::string body;
+	bool keepAlive;
+
+	Request() : keepAlive(false) { }
+	/**
+		@return value of header (name is lower case) or 0
+	*/
+	const std::string *header(const char *name) const
+	{
+		for (size_t i = 0; i < headers.size(); i++) {
+			if (headers[i].first == name) return &headers[i].second;
+		}
+		return 0;
+	}
+};
+
+struct Response {
+	int status;
+	std::string contentType;
+	std::vector<std::pair<std::string, std::string> > headers;
+	std::string body;
+	Response() : status(200) { }
+};
+
+inline const char *reasonPhrase(int status)
+{
+	switch (status) {
+	case 200: return "OK";
+	case 400: return "Bad Request";
+	case 404: return "Not Found";
+	case 411: return "Length Required";
+	case 413: return "Payload Too Large";
+	case 431: return "Request Header Fields Too Large";
+	case 500: return "Internal Server Error";
+	case 501: return "Not Implemented";
+	default: return "Unknown";
+	}
+}
+
+/**
+	consumer of request body which streams its response
+*/
+class Stream {
+public:
+	virtual ~Stream() { }
+	/**
+		consume body data and append response to out
+		@param budget [in] stop consuming when out has budget bytes or more
+		@return consumed bytes of [p, p + n) (less than n only if budget is exhausted)
+	*/
+	virtual size_t write(std::string& out, const char *p, size_t n, size_t budget) = 0;
+	/**
+		end of body
+	*/
+	virtual void finish(std::string& out) = 0;
+};
+
+class Handler {
+public:
+	virtual ~Handler() { }
+	/**
+		make response of request
+		@param thread [in] index of the event loop (0 <= thread < number of threads)
+	*/
+	virtual void handle(Response& res, const Request& req, int thread) = 0;
+	/**
+		streaming response of request, called when the headers are read
+		@param res [out] status and headers (body is ignored)
+		@return new stream (deleted by the server) or 0 to call handle() with the whole body
+	*/
+	virtual Stream *openStream(Response& /*res*/, const Request& /*req*/, int /*thread*/) { return 0; }
+};
+
+struct Config {
+	int port;
+	int threads;
+	int keepAliveTimeout; //!< sec
+	size_t maxHeaderSize;
+	size_t maxBodySize;       //!< of request which is not streamed
+	size_t maxPendingOutput; //!< stop reading requests while more output than this is pending
+	Config()
+		: port(48000), threads(1), keepAliveTimeout(60)
+		, maxHeaderSize(64 * 1024), maxBodySize(16 * 1024 * 1024), maxPendingOutput(1024 * 1024)
+	{
+	}
+};
+
+/**
+	state of an event loop (written by the loop, read by the others)
+*/
+struct LoopStats {
+	std::atomic<int> connections;
+	std::atomic<int> blocked; //!< connections not read while their output is pending
+	std::atomic<int> ready;   //!< events of the last epoll_wait
+	LoopStats() : connections(0), blocked(0), ready(0) { }
+};
+
+namespace http_local {
+
+inline void setNonBlocking(int fd)
+{
+	const int flags = fcntl(fd, F_GETFL, 0);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+inline std::string toLower(const std::string& s)
+{
+	std::string t = s;
+	for (size_t i = 0; i < t.size(); i++) t[i] = (char)tolower((unsigned char)t[i]);
+	return t;
+}
+
+inline std::string trim(const std::string& s, size_t b, size_t e)
+{
+	while (b < e && (s[b] == ' ' || s[b] == '\t')) b++;
+	while (e > b && (s[e - 1] == ' ' || s[e - 1] == '\t' || s[e - 1] == '\r')) e--;
+	return s.substr(b, e - b);
+}
+
+/**
+	reader of request body (Content-Length or chunked)
+*/
+class BodyReader {
+	enum State { Length, ChunkSize, ChunkData, ChunkEnd, Trailer, Done };
+	State state_;
+	uint64_t remaining_;
+public:
+	enum Result { NeedMore, Data, End, Error };
+
+	BodyReader() : state_(Done), remaining_(0) { }
+	void init(bool chunked, uint64_t contentLength)
+	{
+		state_ = chunked ? ChunkSize : Length;
+		remaining_ = chunked ? 0 : contentLength;
+	}
+	/**
+		get next data of body in in[pos, )
+		@param pos [in/out] skips the chunk framing
+		@param n [out] size of data at in[pos, pos + n) if Data
+	*/
+	Result peek(const std::string& in, size_t& pos, size_t& n)
+	{
+		for (;;) {
+			switch (state_) {
+			case Length:
+			case ChunkData:
+				if (remaining_ == 0) {
+					if (state_ == Length) {
+						state_ = Done;
+						return End;
+					}
+					state_ = ChunkEnd;
+					continue;
+				}
+				n = (size_t)std::min<uint64_t>(remaining_, in.size() - pos);
+				return n > 0 ? Data : NeedMore;
+			case ChunkSize:
+			case ChunkEnd:
+			case Trailer:
+				{
+					const size_t eol = in.find("\r\n", pos);
+					if (eol == std::string::npos) return in.size() - pos > 1024 ? Error : NeedMore;
+					const std::string line = in.substr(pos, eol - pos);
+					pos = eol + 2;
+					if (state_ == ChunkEnd) {
+						if (!line.empty()) return Error;
+						state_ = ChunkSize;
+					} else if (state_ == Trailer) {
+						if (line.empty()) {
+							state_ = Done;
+							return End;
+						}
+					} else {
+						if (line.empty() || !isxdigit((unsigned char)line[0])) return Error;
+						remaining_ = strtoull(line.c_str(), 0, 16);
+						state_ = remaining_ == 0 ? Trailer : ChunkData;
+					}
+				}
+				continue;
+			case Done:
+				return End;
+			}
+		}
+	}
+	/**
+		consume n bytes of data returned by peek
+	*/
+	void consume(size_t& pos, size_t n)
+	{
+		pos += n;
+		remaining_ -= n;
+	}
+};
+
+struct Connection {
+	int fd;
+	std::string in;
+	size_t inPos;
+	std::string out;
+	size_t outPos;
+	bool closing;   //!< close after out is written
+	bool peerClosed;
+	bool writing;   //!< waiting EPOLLOUT
+	time_t last;
+	/* request whose body is being read */
+	bool inBody;
+	Request req;
+	BodyReader body;
+	Stream *stream;
+	bool chunked;   //!< response of stream is chunked
+	explicit Connection(int fd)
+		: fd(fd), inPos(0), outPos(0), closing(false), peerClosed(false), writing(false), last(time(0))
+		, inBody(false), stream(0), chunked(false)
+	{
+	}
+	~Connection() { delete stream; }
+	size_t pending() const { return out.size() - outPos; }
+	/* append data as a chunk */
+	void appendChunk(const std::string& data)
+	{
+		if (data.empty()) return;
+		if (!chunked) {
+			out += data;
+			return;
+		}
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%x\r\n", (unsigned int)data.size());
+		out += buf;
+		out += data;
+		out += "\r\n";
+	}
+};
+
+/**
+	one event loop: accepts connections from the shared listening socket
+	and serves them until they are closed
+*/
+class EventLoop {
+	const Config& config_;
+	Handler& handler_;
+	int listenFd_;
+	int index_;
+	LoopStats& stats_;
+	int epfd_;
+	std::unordered_set<Connection*> conns_;
+	EventLoop(const EventLoop&);
+	void operator=(const EventLoop&);
+
+	enum ParseResult { Incomplete, Parsed, Error };
+
+	/*
+		parse request line and headers from c.in[c.inPos, )
+		@param status [out] error status if Error
+	*/
+	ParseResult parse(Request& req, int& status, Connection& c) const
+	{
+		const std::string& in = c.in;
+		const size_t end = in.find("\r\n\r\n", c.inPos);
+		if (end == std::string::npos) {
+			if (in.size() - c.inPos > config_.maxHeaderSize) {
+				status = 431;
+				return Error;
+			}
+			return Incomplete;
+		}
+		size_t p = in.find("\r\n", c.inPos);
+		const std::string line = in.substr(c.inPos, p - c.inPos);
+		const size_t sp1 = line.find(' ');
+		const size_t sp2 = line.rfind(' ');
+		if (sp1 == std::string::npos || sp1 == sp2) {
+			status = 400;
+			return Error;
+		}
+		req.method = line.substr(0, sp1);
+		const std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+		req.version = line.substr(sp2 + 1);
+		const size_t qm = target.find('?');
+		req.path = unquote(target.substr(0, qm));
+		req.query = qm == std::string::npos ? "" : target.substr(qm + 1);
+		req.headers.clear();
+		while (p < end) {
+			p += 2;
+			const size_t q = in.find("\r\n", p);
+			const size_t colon = in.find(':', p);
+			if (colon < q) req.headers.push_back(std::make_pair(toLower(in.substr(p, colon - p)), trim(in, colon + 1, q)));
+			p = q;
+		}
+		const std::string *conn = req.header("connection");
+		const std::string connection = conn ? toLower(*conn) : "";
+		req.keepAlive = req.version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+
+		req.body.clear();
+		uint64_t contentLength = 0;
+		bool chunked = false;
+		if (const std::string *te = req.header("transfer-encoding")) {
+			if (toLower(*te) != "chunked") {
+				status = 501;
+				return Error;
+			}
+			chunked = true;
+		} else if (const std::string *len = req.header("content-length")) {
+			contentLength = strtoull(len->c_str(), 0, 10);
+		}
+		c.body.init(chunked, contentLength);
+		c.inPos = end + 4;
+		return Parsed;
+	}
+
+	static void serializeHeader(std::string& out, const Response& res)
+	{
+		char buf[128];
+		snprintf(buf, sizeof(buf), "HTTP/1.1 %d %s\r\n", res.status, reasonPhrase(res.status));
+		out += buf;
+		if (!res.contentType.empty()) {
+			out += "Content-Type: ";
+			out += res.contentType;
+			out += "\r\n";
+		}
+		for (size_t i = 0; i < res.headers.size(); i++) {
+			out += res.headers[i].first;
+			out += ": ";
+			out += res.headers[i].second;
+			out += "\r\n";
+		}
+	}
+
+	static void serialize(std::string& out, const Response& res, bool keepAlive)
+	{
+		char buf[128];
+		serializeHeader(out, res);
+		snprintf(buf, sizeof(buf), "Content-Length: %d\r\nConnection: %s\r\n\r\n", (int)res.body.size(), keepAlive ? "keep-alive" : "close");
+		out += buf;
+		out += res.body;
+	}
+
+	void error(Connection& c, int status)
+	{
+		Response res;
+		res.status = status;
+		res.contentType = "text/plain";
+		res.body = reasonPhrase(status);
+		serialize(c.out, res, false);
+		c.closing = true;
+	}
+
+	static void internalError(Response& res, const std::exception& e)
+	{
+		fprintf(stderr, "ERR:%s\n", e.what());
+		res = Response();
+		res.status = 500;
+		res.contentType = "text/plain";
+		res.body = reasonPhrase(500);
+	}
+
+	/* called when the headers of c.req are read */
+	void begin(Connection& c)
+	{
+		const Request& req = c.req;
+		Response res;
+		try {
+			c.stream = handler_.openStream(res, req, index_);
+		} catch (std::exception& e) {
+			internalError(res, e);
+			serialize(c.out, res, false);
+			c.closing = true;
+			return;
+		}
+		const std::string *len = req.header("content-length");
+		if (!c.stream && len && strtoull(len->c_str(), 0, 10) > config_.maxBodySize) {
+			error(c, 413);
+			return;
+		}
+		const std::string *expect = req.header("expect");
+		if (expect && toLower(*expect) == "100-continue") c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+		if (c.stream) {
+			/* HTTP/1.0 can't receive chunks, so the end of response is the close */
+			c.chunked = req.version == "HTTP/1.1";
+			if (!c.chunked) c.req.keepAlive = false;
+			serializeHeader(c.out, res);
+			c.out += c.chunked ? "Transfer-Encoding: chunked\r\n" : "";
+			c.out += c.req.keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+		}
+		c.inBody = true;
+	}
+
+	/* called when the body of c.req is read */
+	void end(Connection& c)
+	{
+		if (c.stream) {
+			std::string data;
+			try {
+				c.stream->finish(data);
+			} catch (std::exception& e) {
+				/* the status is already sent, so the response is broken off */
+				fprintf(stderr, "ERR:%s\n", e.what());
+				c.closing = true;
+			}
+			c.appendChunk(data);
+			if (c.chunked && !c.closing) c.out += "0\r\n\r\n";
+			delete c.stream;
+			c.stream = 0;
+		} else {
+			Response res;
+			try {
+				handler_.handle(res, c.req, index_);
+			} catch (std::exception& e) {
+				internalError(res, e);
+			}
+			serialize(c.out, res, c.req.keepAlive);
+		}
+		if (!c.req.keepAlive) c.closing = true;
+		c.inBody = false;
+	}
+
+	/*
+		read body of c.req
+		@return false if more input is needed or output is full
+	*/
+	bool readBody(Connection& c)
+	{
+		for (;;) {
+			size_t n = 0;
+			const BodyReader::Result r = c.body.peek(c.in, c.inPos, n);
+			if (r == BodyReader::NeedMore) return false;
+			if (r == BodyReader::End) {
+				end(c);
+				return true;
+			}
+			if (r == BodyReader::Error) {
+				if (c.stream) {
+					/* the status is already sent */
+					c.closing = true;
+				} else {
+					error(c, 400);
+				}
+				return false;
+			}
+			if (c.stream) {
+				if (c.pending() >= config_.maxPendingOutput) return false;
+				std::string data;
+				size_t consumed = 0;
+				try {
+					consumed = c.stream->write(data, c.in.data() + c.inPos, n, config_.maxPendingOutput - c.pending());
+				} catch (std::exception& e) {
+					fprintf(stderr, "ERR:%s\n", e.what());
+					c.closing = true;
+					return false;
+				}
+				c.appendChunk(data);
+				c.body.consume(c.inPos, consumed);
+				if (consumed < n) return false;
+			} else {
+				if (c.req.body.size() + n > config_.maxBodySize) {
+					error(c, 413);
+					return false;
+				}
+				c.req.body.append(c.in, c.inPos, n);
+				c.body.consume(c.inPos, n);
+			}
+		}
+	}
+
+	/*
+		handle requests in c.in
+		@return true if it stops because of pending output
+	*/
+	bool process(Connection& c)
+	{
+		bool needInput = false;
+		while (!c.closing && c.pending() < config_.maxPendingOutput) {
+			if (!c.inBody) {
+				int status = 0;
+				const ParseResult r = parse(c.req, status, c);
+				if (r == Incomplete) {
+					needInput = true;
+					break;
+				}
+				if (r == Error) {
+					error(c, status);
+					break;
+				}
+				begin(c);
+				continue;
+			}
+			if (!readBody(c)) {
+				needInput = c.inBody && !c.closing && c.pending() < config_.maxPendingOutput;
+				break;
+			}
+		}
+		/* nothing will come from the peer */
+		if (needInput && c.peerClosed) c.closing = true;
+		if (c.inPos > 0 && c.inPos * 2 >= c.in.size()) {
+			c.in.erase(0, c.inPos);
+			c.inPos = 0;
+		}
+		return !c.closing && c.pending() >= config_.maxPendingOutput;
+	}
+
+	/* process and write until more input or EPOLLOUT is needed */
+	void serve(Connection& c)
+	{
+		for (;;) {
+			const bool full = process(c);
+			if (!flush(c)) return;
+			if (!full || c.writing) return;
+		}
+	}
+
+	/* @return false if the connection is closed */
+	bool flush(Connection& c)
+	{
+		while (c.pending() > 0) {
+			const ssize_t n = send(c.fd, c.out.data() + c.outPos, c.pending(), MSG_NOSIGNAL);
+			if (n < 0) {
+				if (errno == EINTR) continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+				close(c);
+				return false;
+			}
+			c.outPos += n;
+		}
+		if (c.pending() == 0) {
+			c.out.clear();
+			c.outPos = 0;
+			if (c.closing) {
+				close(c);
+				return false;
+			}
+		}
+		/* read no more request while the response is pending (backpressure) */
+		const bool writing = c.pending() > 0;
+		if (writing != c.writing) {
+			c.writing = writing;
+			stats_.blocked.store(stats_.blocked.load(std::memory_order_relaxed) + (writing ? 1 : -1), std::memory_order_relaxed);
+			epoll_event ev;
+			ev.events = writing ? EPOLLOUT : EPOLLIN;
+			ev.data.ptr = &c;
+			epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+		}
+		return true;
+	}
+
+	void onReadable(Connection& c)
+	{
+		char buf[65536];
+		for (;;) {
+			const ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+			if (n < 0) {
+				if (errno == EINTR) continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+				close(c);
+				return;
+			}
+			if (n == 0) {
+				c.peerClosed = true;
+				break;
+			}
+			c.in.append(buf, n);
+			/* the body of stream is read by pieces */
+			if (c.in.size() - c.inPos > config_.maxHeaderSize + (c.stream ? config_.maxPendingOutput : config_.maxBodySize)) break;
+		}
+		c.last = time(0);
+		serve(c);
+	}
+
+	void onWritable(Connection& c)
+	{
+		c.last = time(0);
+		if (!flush(c)) return;
+		if (!c.writing) serve(c);
+	}
+
+	void accept()
+	{
+		for (int i = 0; i < 16; i++) {
+			const int fd = accept4(listenFd_, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0) return;
+			const int one = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			Connection *c = new Connection(fd);
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = c;
+			if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+				::close(fd);
+				delete c;
+				continue;
+			}
+			conns_.insert(c);
+			stats_.connections.store((int)conns_.size(), std::memory_order_relaxed);
+		}
+	}
+
+	void close(Connection& c)
+	{
+		epoll_ctl(epfd_, EPOLL_CTL_DEL, c.fd, 0);
+		::close(c.fd);
+		conns_.erase(&c);
+		if (c.writing) stats_.blocked.store(stats_.blocked.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+		stats_.connections.store((int)conns_.size(), std::memory_order_relaxed);
+		delete &c;
+	}
+
+	void closeIdle()
+	{
+		const time_t now = time(0);
+		std::vector<Connection*> idle;
+		for (std::unordered_set<Connection*>::const_iterator i = conns_.begin(); i != conns_.end(); ++i) {
+			if (now - (*i)->last > config_.keepAliveTimeout) idle.push_back(*i);
+		}
+		for (size_t i = 0; i < idle.size(); i++) close(*idle[i]);
+	}
+public:
+	EventLoop(const Config& config, Handler& handler, int listenFd, int index, LoopStats& stats)
+		: config_(config), handler_(handler), listenFd_(listenFd), index_(index), stats_(stats)
+		, epfd_(epoll_create1(EPOLL_CLOEXEC))
+	{
+		if (epfd_ < 0) {
+			Exception e;
+			e << "epoll_create1" << cybozu::ErrorNo().toString();
+			throw e;
+		}
+		epoll_event ev;
+		ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+		ev.data.ptr = 0;
+		if (epoll_ctl(epfd_, EPOLL_CTL_ADD, listenFd_, &ev) < 0) {
+			Exception e;
+			e << "epoll_ctl" << cybozu::ErrorNo().toString();
+			throw e;
+		}
+	}
+	~EventLoop()
+	{
+		while (!conns_.empty()) close(**conns_.begin());
+		::close(epfd_);
+	}
+	void run()
+	{
+		epoll_event events[256];
+		time_t lastSweep = time(0);
+		for (;;) {
+			const int n = epoll_wait(epfd_, events, 256, 1000);
+			stats_.ready.store(std::max(n, 0), std::memory_order_relaxed);
+			for (int i = 0; i < n; i++) {
+				Connection *c = (Connection*)events[i].data.ptr;
+				if (c == 0) {
+					accept();
+				} else if (events[i].events & EPOLLOUT) {
+					onWritable(*c);
+				} else if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+					onReadable(*c);
+				}
+			}
+			const time_t now = time(0);
+			if (now != lastSweep) {
+				lastSweep = now;
+				closeIdle();
+			}
+		}
+	}
+};
+
+} // http_local
+
+/**
+	HTTP server
+	each thread runs its own event loop; the connections are distributed by EPOLLEXCLUSIVE
+	and a request is handled on the thread which accepted the connection.
+*/
+class Server {
+	Config config_;
+	Handler& handler_;
+	int listenFd_;
+	std::unique_ptr<LoopStats[]> stats_;
+	Server(const Server&);
+	void operator=(const Server&);
+
+	static void runLoop(const Config *config, Handler *handler, int listenFd, int index, LoopStats *stats)
+	{
+		try {
+			http_local::EventLoop loop(*config, *handler, listenFd, index, *stats);
+			loop.run();
+		} catch (std::exception& e) {
+			fprintf(stderr, "ERR:%s\n", e.what());
+			exit(1);
+		}
+	}
+public:
+	Server(const Config& config, Handler& handler)
+		: config_(config), handler_(handler), listenFd_(socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0))
+		, stats_(new LoopStats[config.threads])
+	{
+		if (listenFd_ < 0) {
+			Exception e;
+			e << "socket" << cybozu::ErrorNo().toString();
+			throw e;
+		}
+		const int one = 1, zero = 0;
+		setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		setsockopt(listenFd_, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+		sockaddr_in6 addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin6_family = AF_INET6;
+		addr.sin6_addr = in6addr_any;
+		addr.sin6_port = htons((uint16_t)config_.port);
+		if (bind(listenFd_, (const sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd_, SOMAXCONN) < 0) {
+			Exception e;
+			e << "bind" << config_.port << cybozu::ErrorNo().toString();
+			::close(listenFd_);
+			throw e;
+		}
+		http_local::setNonBlocking(listenFd_);
+		signal(SIGPIPE, SIG_IGN);
+	}
+	~Server() { ::close(listenFd_); }
+	int threads() const { return config_.threads; }
+	/**
+		state of the event loop of thread
+	*/
+	const LoopStats& loopStats(int thread) const { return stats_[thread]; }
+	/**
+		serve forever
+	*/
+	void run()
+	{
+		std::vector<std::thread> threads;
+		for (int i = 1; i < config_.threads; i++) {
+			threads.push_back(std::thread(runLoop, &config_, &handler_, listenFd_, i, &stats_[i]));
+		}
+		runLoop(&config_, &handler_, listenFd_, 0, &stats_[0]);
+		for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+	}
+};
+
+} // http
+
+} // ldig
@@ -0,0 +1,52 @@
+#pragma once
+/**
+	@file
+	@brief JSON strings of the outputs
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include <stdio.h>
+#include "normalize.hpp"
+
+namespace ldig {
+
+/* append s as JSON string the same as json.dump of python (ensure_ascii) */
+inline void appendJsonString(std::string& out, const cybozu::String& s)
+{
+	char buf[16];
+	out += '"';
+	for (size_t i = 0; i < s.size(); i++) {
+		const cybozu::Char c = s[i];
+		switch (c) {
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\b': out += "\\b"; break;
+		case '\f': out += "\\f"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if (0x20 <= c && c < 0x7f) {
+				out += (char)c;
+			} else if (c < 0x10000) {
+				snprintf(buf, sizeof(buf), "\\u%04x", (unsigned int)c);
+				out += buf;
+			} else {
+				const unsigned int v = c - 0x10000;
+				snprintf(buf, sizeof(buf), "\\u%04x\\u%04x", 0xd800 + (v >> 10), 0xdc00 + (v & 0x3ff));
+				out += buf;
+			}
+		}
+	}
+	out += '"';
+}
+
+inline void appendJsonString(std::string& out, const std::string& s)
+{
+	cybozu::String t;
+	decodeUtf8(t, s.data(), s.data() + s.size());
+	appendJsonString(out, t);
+}
+
+} // ldig
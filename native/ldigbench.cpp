@@ -0,0 +1,473 @@
+/**
+	@file
+	@brief benchmark of the detection paths on texts generated from the features of a model
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <memory>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "detector.hpp"
+
+const double acceptThreshold = 0.6; // same as ldig.likelihood
+
+struct Options {
+	std::string model;
+	std::string report;
+	std::string labels;
+	std::vector<std::string> paths;
+	size_t texts;
+	int threads;
+	unsigned int seed;
+	Options() : model("../models/ldig.model.small.tgz"), texts(1000), threads((int)std::max(1u, std::thread::hardware_concurrency())), seed(1) { }
+};
+
+enum Path {
+	pathDetect,
+	pathExplain,
+	pathEarlyExit,
+	pathSubset,
+	pathSession,
+	pathSegment,
+	pathN
+};
+
+const char *pathName(int path)
+{
+	static const char *tbl[] = { "detect", "explain", "early-exit", "subset", "session", "segment" };
+	return tbl[path];
+}
+
+void usage()
+{
+	std::cerr << "usage: ldigbench [-m model directory or .tgz] [-n texts] [-t max threads] [-p paths] [-l labels] [--seed seed] [-o result.json]" << std::endl;
+	std::cerr << "paths:";
+	for (int i = 0; i < pathN; i++) std::cerr << ' ' << pathName(i);
+	std::cerr << std::endl;
+	exit(1);
+}
+
+void parseOptions(Options& opt, int argc, char *argv[])
+{
+	std::string paths;
+	for (int i = 1; i < argc; i++) {
+		const std::string a = argv[i];
+		if (i + 1 < argc && a == "-m") {
+			opt.model = argv[++i];
+		} else if (i + 1 < argc && a == "-n") {
+			opt.texts = std::max(1, atoi(argv[++i]));
+		} else if (i + 1 < argc && a == "-t") {
+			opt.threads = std::max(1, atoi(argv[++i]));
+		} else if (i + 1 < argc && a == "-p") {
+			paths = argv[++i];
+		} else if (i + 1 < argc && a == "-l") {
+			opt.labels = argv[++i];
+		} else if (i + 1 < argc && a == "--seed") {
+			opt.seed = (unsigned int)strtoul(argv[++i], 0, 10);
+		} else if (i + 1 < argc && a == "-o") {
+			opt.report = argv[++i];
+		} else {
+			usage();
+		}
+	}
+	for (size_t p = 0; p < paths.size(); ) {
+		size_t q = paths.find(',', p);
+		if (q == std::string::npos) q = paths.size();
+		opt.paths.push_back(paths.substr(p, q - p));
+		p = q + 1;
+	}
+	for (size_t i = 0; i < opt.paths.size(); i++) {
+		int j = 0;
+		while (j < pathN && opt.paths[i] != pathName(j)) j++;
+		if (j == pathN) usage();
+	}
+}
+
+bool endsWith(const std::string& s, const std::string& t)
+{
+	return s.size() >= t.size() && s.compare(s.size() - t.size(), t.size(), t) == 0;
+}
+
+/* s as an argument of sh */
+std::string shellQuote(const std::string& s)
+{
+	std::string q = "'";
+	for (size_t i = 0; i < s.size(); i++) {
+		if (s[i] == '\'') {
+			q += "'\\''";
+		} else {
+			q += s[i];
+		}
+	}
+	return q + "'";
+}
+
+/*
+	temporary directory (removed with its files at destruction)
+*/
+class TempDir {
+	std::string path_;
+	TempDir(const TempDir&);
+	void operator=(const TempDir&);
+public:
+	TempDir() { }
+	void make()
+	{
+		char tmp[] = "/tmp/ldigbench.XXXXXX";
+		if (mkdtemp(tmp) == 0) throw cybozu::Exception("ldigbench") << "can't make temporary directory";
+		path_ = tmp;
+	}
+	~TempDir()
+	{
+		if (path_.empty()) return;
+		const std::string cmd = "rm -rf " + shellQuote(path_);
+		if (system(cmd.c_str()) != 0) std::cerr << "can't remove " << path_ << std::endl;
+	}
+	const std::string& path() const { return path_; }
+};
+
+/*
+	model directory extracted from a .tgz into a temporary directory
+	(removed at exit, or when the model isn't found)
+*/
+class ModelDir {
+	TempDir tmp_;
+	std::string dir_;
+	ModelDir(const ModelDir&);
+	void operator=(const ModelDir&);
+public:
+	explicit ModelDir(const std::string& path)
+	{
+		if (!endsWith(path, ".tgz") && !endsWith(path, ".tar.gz")) {
+			dir_ = path;
+			return;
+		}
+		tmp_.make();
+		const std::string cmd = "tar xzf " + shellQuote(path) + " -C " + shellQuote(tmp_.path());
+		if (system(cmd.c_str()) != 0) throw cybozu::Exception("ldigbench") << "can't extract" << path;
+		/* the directory of labels.json in the archive */
+		const std::string find = "find " + shellQuote(tmp_.path()) + " -name labels.json";
+		FILE *fp = popen(find.c_str(), "r");
+		char buf[1024];
+		if (fp && fgets(buf, sizeof(buf), fp)) {
+			dir_ = buf;
+			dir_.erase(dir_.rfind('/'));
+		}
+		if (fp) pclose(fp);
+		if (dir_.empty()) throw cybozu::Exception("ldigbench") << "no model in" << path;
+	}
+	const std::string& dir() const { return dir_; }
+};
+
+size_t countChars(const std::string& s)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < s.size(); i++) {
+		if (((unsigned char)s[i] & 0xc0) != 0x80) n++;
+	}
+	return n;
+}
+
+struct TextSet {
+	std::string name;
+	std::vector<std::string> texts;
+	size_t chars;
+};
+
+/*
+	texts of a label are the features whose largest weight is of the label
+	(without the boundary marks) drawn by their frequencies and joined by spaces
+*/
+class Generator {
+	std::vector<std::vector<std::string> > words_; //!< [label]
+	std::vector<std::vector<double> > cum_; //!< [label] cumulative frequencies of words
+public:
+	explicit Generator(const ldig::Model& model)
+		: words_(model.K), cum_(model.K)
+	{
+		std::string buf;
+		ldig::readFile(buf, model.featuresPath());
+		/* in the order of features (not of ids), so a renumbered model gives the same texts */
+		std::vector<std::pair<std::string, size_t> > features;
+		features.reserve(model.M);
+		for (size_t p = 0; p < buf.size() && features.size() < model.M;) {
+			size_t q = buf.find('\n', p);
+			if (q == std::string::npos) q = buf.size();
+			const size_t tab = buf.rfind('\t', q);
+			if (tab == std::string::npos || tab <= p) throw cybozu::Exception("ldigbench") << "irregular feature" << features.size() + 1;
+			features.push_back(std::make_pair(buf.substr(p, q - p), features.size()));
+			p = q + 1;
+		}
+		std::sort(features.begin(), features.end());
+		for (size_t i = 0; i < features.size(); i++) {
+			const std::string& line = features[i].first;
+			const size_t id = features[i].second;
+			const size_t tab = line.rfind('\t');
+			std::string w = line.substr(0, tab);
+			const double freq = atof(line.c_str() + tab + 1);
+			if (!w.empty() && w[0] == 1) w.erase(0, 1);
+			if (!w.empty() && w[w.size() - 1] == 1) w.erase(w.size() - 1);
+			while (!w.empty() && w[0] == ' ') w.erase(0, 1);
+			while (!w.empty() && w[w.size() - 1] == ' ') w.erase(w.size() - 1);
+			if (w.empty() || freq <= 0) continue;
+			const double *phi = &model.param[id * model.K];
+			const size_t k = std::max_element(phi, phi + model.K) - phi;
+			if (phi[k] <= 0) continue;
+			words_[k].push_back(w);
+			cum_[k].push_back((cum_[k].empty() ? 0 : cum_[k].back()) + freq);
+		}
+	}
+	/*
+		n texts of the lengths (characters) drawn log-uniformly from [minLen, maxLen]
+	*/
+	void generate(TextSet& set, size_t n, size_t minLen, size_t maxLen, std::mt19937& rg) const
+	{
+		std::vector<size_t> labels;
+		for (size_t k = 0; k < words_.size(); k++) {
+			if (!words_[k].empty()) labels.push_back(k);
+		}
+		if (labels.empty()) throw cybozu::Exception("ldigbench") << "no feature to generate texts";
+		std::uniform_real_distribution<double> logLen(std::log((double)minLen), std::log((double)maxLen + 1));
+		std::uniform_int_distribution<size_t> label(0, labels.size() - 1);
+		set.texts.resize(n);
+		set.chars = 0;
+		for (size_t i = 0; i < n; i++) {
+			const size_t k = labels[label(rg)];
+			const std::vector<double>& cum = cum_[k];
+			std::uniform_real_distribution<double> u(0, cum.back());
+			const size_t len = (size_t)std::exp(logLen(rg));
+			std::string& text = set.texts[i];
+			size_t chars = 0;
+			while (chars < len) {
+				const std::string& w = words_[k][std::upper_bound(cum.begin(), cum.end(), u(rg)) - cum.begin()];
+				if (chars > 0) {
+					text += ' ';
+					chars++;
+				}
+				text += w;
+				chars += countChars(w);
+			}
+			set.chars += chars;
+		}
+	}
+};
+
+struct Bench {
+	const ldig::Detector& detector;
+	const ldig::Detector& early; //!< with early exit
+	std::shared_ptr<const ldig::LabelSubset> subset;
+	Bench(const ldig::Detector& detector, const ldig::Detector& early, const std::string& labels)
+		: detector(detector), early(early), subset(detector.subset(labels))
+	{
+	}
+};
+
+/*
+	run path on set[begin, end)
+	@param latency [out] ns of each operation if not 0
+	@return number of operations (a text, or a word typed in session)
+*/
+size_t run(const Bench& b, Path path, const TextSet& set, size_t begin, size_t end, std::vector<uint64_t> *latency)
+{
+	ldig::Detector::Work w;
+	std::string json, prefix;
+	size_t ops = 0;
+	for (size_t i = begin; i < end; i++) {
+		const std::string& text = set.texts[i];
+		if (path == pathSession) {
+			/* typing of the words, and detection at each space and at the end */
+			ldig::Session session(b.detector.model());
+			for (size_t pos = 0; pos <= text.size(); pos++) {
+				if (pos < text.size() && text[pos] != ' ') continue;
+				prefix.assign(text, 0, pos);
+				const uint64_t t = ldig::nowNs();
+				b.detector.detect(json, w, session, prefix);
+				if (latency) latency->push_back(ldig::nowNs() - t);
+				ops++;
+			}
+			continue;
+		}
+		const uint64_t t = ldig::nowNs();
+		switch (path) {
+		case pathDetect: b.detector.detect(json, w, text); break;
+		case pathExplain: b.detector.detect(json, w, text, true); break;
+		case pathEarlyExit: b.early.detect(json, w, text); break;
+		case pathSubset: b.detector.detect(json, w, text, false, b.subset.get()); break;
+		case pathSegment: b.detector.segment(json, w, text); break;
+		default: break;
+		}
+		if (latency) latency->push_back(ldig::nowNs() - t);
+		ops++;
+	}
+	return ops;
+}
+
+struct Result {
+	Path path;
+	const TextSet *set;
+	int threads;
+	size_t ops;
+	double sec;
+	double p50, p99, p999, max; //!< us (single thread only)
+};
+
+double percentile(const std::vector<uint64_t>& sorted, double p)
+{
+	if (sorted.empty()) return 0;
+	size_t i = (size_t)std::ceil(p * sorted.size()); // nearest rank
+	if (i > 0) i--;
+	return sorted[std::min(i, sorted.size() - 1)] * 1e-3;
+}
+
+void runThread(size_t *ops, const Bench *b, Path path, const TextSet *set)
+{
+	*ops = run(*b, path, *set, 0, set->texts.size(), 0);
+}
+
+/*
+	each thread runs the whole set, so the throughput of t threads is t times of one thread if it scales
+*/
+void measure(Result& r, const Bench& b)
+{
+	const TextSet& set = *r.set;
+	std::vector<uint64_t> latency;
+	run(b, r.path, set, 0, std::min<size_t>(set.texts.size(), 100), 0); // warm up
+	const uint64_t start = ldig::nowNs();
+	if (r.threads == 1) {
+		r.ops = run(b, r.path, set, 0, set.texts.size(), &latency);
+	} else {
+		std::vector<size_t> ops(r.threads);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < r.threads; t++) {
+			threads.push_back(std::thread(runThread, &ops[t], &b, r.path, &set));
+		}
+		for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+		r.ops = 0;
+		for (size_t t = 0; t < ops.size(); t++) r.ops += ops[t];
+	}
+	r.sec = (ldig::nowNs() - start) * 1e-9;
+	std::sort(latency.begin(), latency.end());
+	r.p50 = percentile(latency, 0.5);
+	r.p99 = percentile(latency, 0.99);
+	r.p999 = percentile(latency, 0.999);
+	r.max = latency.empty() ? 0 : latency.back() * 1e-3;
+}
+
+void printRow(std::ostream& os, const Result& r)
+{
+	char buf[256];
+	const size_t chars = r.path == pathSession ? 0 : r.set->chars * r.threads;
+	snprintf(buf, sizeof(buf), "%s,%s,%d,%d,%.6f,%.1f,%.1f,", pathName(r.path), r.set->name.c_str(), r.threads, (int)r.ops, r.sec,
+		r.ops / r.sec, chars / r.sec);
+	os << buf;
+	if (r.threads == 1) {
+		snprintf(buf, sizeof(buf), "%.3f,%.3f,%.3f,%.3f", r.p50, r.p99, r.p999, r.max);
+		os << buf;
+	} else {
+		os << ",,,";
+	}
+	os << '\n';
+}
+
+void writeReport(const std::string& path, const Options& opt, const std::vector<TextSet>& sets, const std::vector<Result>& results)
+{
+	std::ofstream ofs(path.c_str());
+	if (!ofs) {
+		cybozu::Exception e("ldigbench");
+		e << "can't open" << path;
+		throw e;
+	}
+	char buf[512];
+	ofs << "{\n  \"model\": ";
+	std::string s;
+	ldig::appendJsonString(s, opt.model);
+	ofs << s;
+	snprintf(buf, sizeof(buf), ",\n  \"seed\": %u,\n  \"texts\": %d,\n  \"sets\": [", opt.seed, (int)opt.texts);
+	ofs << buf;
+	for (size_t i = 0; i < sets.size(); i++) {
+		snprintf(buf, sizeof(buf), "%s\n    {\"name\": \"%s\", \"texts\": %d, \"chars\": %d}", i ? "," : "",
+			sets[i].name.c_str(), (int)sets[i].texts.size(), (int)sets[i].chars);
+		ofs << buf;
+	}
+	ofs << "\n  ],\n  \"results\": [";
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		snprintf(buf, sizeof(buf), "%s\n    {\"path\": \"%s\", \"set\": \"%s\", \"threads\": %d, \"ops\": %d, \"sec\": %.6f, \"ops_per_sec\": %.1f",
+			i ? "," : "", pathName(r.path), r.set->name.c_str(), r.threads, (int)r.ops, r.sec, r.ops / r.sec);
+		ofs << buf;
+		if (r.threads == 1) {
+			snprintf(buf, sizeof(buf), ", \"latency_us\": {\"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}", r.p50, r.p99, r.p999, r.max);
+			ofs << buf;
+		}
+		ofs << "}";
+	}
+	ofs << "\n  ]\n}\n";
+}
+
+int main(int argc, char *argv[])
+	try
+{
+	Options opt;
+	parseOptions(opt, argc, argv);
+
+	ModelDir dir(opt.model);
+	ldig::Model model;
+	model.load(dir.dir());
+	ldig::EarlyExit earlyExit(model, acceptThreshold);
+	ldig::Detector detector(model), early(model);
+	early.setEarlyExit(&earlyExit);
+	if (opt.labels.empty()) {
+		for (size_t k = 0; k < std::min<size_t>(3, model.K); k++) opt.labels += (k ? "," : "") + model.labels[k];
+	}
+	Bench bench(detector, early, opt.labels);
+
+	/* the same seed generates the same texts from the same model */
+	Generator gen(model);
+	std::mt19937 rg(opt.seed);
+	std::vector<TextSet> sets(3);
+	sets[0].name = "short";
+	gen.generate(sets[0], opt.texts, 10, 140, rg);
+	sets[1].name = "medium";
+	gen.generate(sets[1], opt.texts, 141, 1000, rg);
+	sets[2].name = "long";
+	gen.generate(sets[2], std::max<size_t>(1, opt.texts / 10), 1001, 10000, rg);
+
+	std::vector<int> threads;
+	for (int t = 1; t < opt.threads; t *= 2) threads.push_back(t);
+	threads.push_back(opt.threads);
+
+	std::vector<Result> results;
+	std::cout << "path,set,threads,ops,sec,ops_per_sec,chars_per_sec,p50_us,p99_us,p999_us,max_us" << std::endl;
+	for (int p = 0; p < pathN; p++) {
+		if (!opt.paths.empty() && std::find(opt.paths.begin(), opt.paths.end(), pathName(p)) == opt.paths.end()) continue;
+		for (size_t s = 0; s < sets.size(); s++) {
+			/* typing a long text is quadratic */
+			if (p == pathSession && sets[s].name != "short") continue;
+			for (size_t t = 0; t < threads.size(); t++) {
+				Result r;
+				r.path = (Path)p;
+				r.set = &sets[s];
+				r.threads = threads[t];
+				measure(r, bench);
+				printRow(std::cout, r);
+				std::cout.flush();
+				results.push_back(r);
+			}
+		}
+	}
+	if (!opt.report.empty()) writeReport(opt.report, opt, sets, results);
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "ERR:" << e.what() << std::endl;
+	return 1;
+}
@@ -0,0 +1,765 @@
+/**
+	@file
+	@brief ldig server (native version of server.py)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "detector.hpp"
+#include "httpd.hpp"
+#include "metrics.hpp"
+
+struct Options {
+	std::string model;
+	std::string staticDir;
+	size_t cacheSize;
+	bool earlyExit;
+	size_t sessions;
+	size_t sessionMemory; //!< MB
+	bool profile;
+	ldig::http::Config http;
+	Options() : cacheSize(0), earlyExit(false), sessions(1024), sessionMemory(256), profile(false)
+	{
+		http.threads = (int)std::max(1u, std::thread::hardware_concurrency());
+	}
+};
+
+void usage()
+{
+	std::cerr << "usage: ldigd -m [model directory] [-p port] [-t threads] [-d static directory] [-c cache entries] [--early-exit] [-s sessions] [--session-memory MB] [--profile]" << std::endl;
+	exit(1);
+}
+
+void parseOptions(Options& opt, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const std::string a = argv[i];
+		if (i + 1 < argc && a == "-m") {
+			opt.model = argv[++i];
+		} else if (i + 1 < argc && a == "-p") {
+			opt.http.port = atoi(argv[++i]);
+		} else if (i + 1 < argc && a == "-t") {
+			opt.http.threads = std::max(1, atoi(argv[++i]));
+		} else if (i + 1 < argc && a == "-d") {
+			opt.staticDir = argv[++i];
+		} else if (i + 1 < argc && a == "-c") {
+			opt.cacheSize = strtoul(argv[++i], 0, 10);
+		} else if (i + 1 < argc && a == "-s") {
+			opt.sessions = strtoul(argv[++i], 0, 10);
+		} else if (i + 1 < argc && a == "--session-memory") {
+			opt.sessionMemory = strtoul(argv[++i], 0, 10);
+		} else if (a == "--early-exit") {
+			opt.earlyExit = true;
+		} else if (a == "--profile") {
+			opt.profile = true;
+		} else {
+			usage();
+		}
+	}
+	if (opt.model.empty()) usage();
+	if (opt.earlyExit && opt.profile) {
+		/* early exit scans a part of the text without extraction, which the profile can't count */
+		std::cerr << "ldigd: --early-exit and --profile can't be used together" << std::endl;
+		exit(1);
+	}
+	if (opt.staticDir.empty()) {
+		/* static/ of the repository (ldigd is built in native/) */
+		const std::string self = argv[0];
+		const size_t slash = self.rfind('/');
+		opt.staticDir = (slash == std::string::npos ? std::string(".") : self.substr(0, slash)) + "/../static";
+	}
+}
+
+/*
+	read JSON string at s[i] (= '"') into UTF-8
+	@return false if s[i, ) is not JSON string
+*/
+bool parseJsonString(std::string& out, const std::string& s, size_t& i)
+{
+	out.clear();
+	if (i >= s.size() || s[i] != '"') return false;
+	for (i++; i < s.size(); i++) {
+		const char c = s[i];
+		if (c == '"') {
+			i++;
+			return true;
+		}
+		if (c != '\\') {
+			out += c;
+			continue;
+		}
+		if (++i >= s.size()) return false;
+		switch (s[i]) {
+		case 'b': out += '\b'; break;
+		case 'f': out += '\f'; break;
+		case 'n': out += '\n'; break;
+		case 'r': out += '\r'; break;
+		case 't': out += '\t'; break;
+		case 'u':
+			{
+				if (i + 4 >= s.size()) return false;
+				cybozu::Char u = (cybozu::Char)strtol(s.substr(i + 1, 4).c_str(), 0, 16);
+				i += 4;
+				/* surrogate pair */
+				if (0xd800 <= u && u < 0xdc00 && i + 6 < s.size() && s[i + 1] == '\\' && s[i + 2] == 'u') {
+					const cybozu::Char v = (cybozu::Char)strtol(s.substr(i + 3, 4).c_str(), 0, 16);
+					if (0xdc00 <= v && v < 0xe000) {
+						u = 0x10000 + ((u - 0xd800) << 10) + (v - 0xdc00);
+						i += 6;
+					}
+				}
+				cybozu::string::AppendUtf8(out, u);
+			}
+			break;
+		default:
+			out += s[i];
+		}
+	}
+	return false;
+}
+
+/*
+	skip JSON value at s[i]
+	@return false if it is broken
+*/
+bool skipJsonValue(const std::string& s, size_t& i)
+{
+	std::string work;
+	int depth = 0;
+	while (i < s.size()) {
+		const char c = s[i];
+		if (c == '"') {
+			if (!parseJsonString(work, s, i)) return false;
+		} else {
+			if (depth == 0 && (c == ',' || c == '}' || c == ']')) return true;
+			if (c == '{' || c == '[') depth++;
+			if (c == '}' || c == ']') depth--;
+			i++;
+		}
+		if (depth == 0 && i < s.size() && (s[i] == ',' || s[i] == '}' || s[i] == ']')) return true;
+	}
+	return false;
+}
+
+inline void skipSpace(const std::string& s, size_t& i)
+{
+	while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r')) i++;
+}
+
+/*
+	read {"text": "...", "id": ...}
+	@param id [out] raw JSON value of "id" ("" if none)
+*/
+bool parseJsonObject(std::string& text, std::string& id, const std::string& s)
+{
+	bool hasText = false;
+	std::string key;
+	id.clear();
+	size_t i = 0;
+	skipSpace(s, i);
+	if (i >= s.size() || s[i] != '{') return false;
+	i++;
+	for (;;) {
+		skipSpace(s, i);
+		if (i < s.size() && s[i] == '}') return hasText;
+		if (!parseJsonString(key, s, i)) return false;
+		skipSpace(s, i);
+		if (i >= s.size() || s[i] != ':') return false;
+		i++;
+		skipSpace(s, i);
+		const size_t begin = i;
+		if (key == "text") {
+			if (!parseJsonString(text, s, i)) return false;
+			hasText = true;
+		} else {
+			if (!skipJsonValue(s, i)) return false;
+			if (key == "id") {
+				id = s.substr(begin, i - begin);
+				while (!id.empty() && (id[id.size() - 1] == ' ' || id[id.size() - 1] == '\t')) id.resize(id.size() - 1);
+			}
+		}
+		skipSpace(s, i);
+		if (i < s.size() && s[i] == ',') i++;
+	}
+}
+
+enum Endpoint {
+	epDetect,
+	epBatch,
+	epSegment,
+	epStats,
+	epMetrics,
+	epProfile,
+	epStatic,
+	epOther,
+	endpointN
+};
+
+const char *endpointName(int ep)
+{
+	static const char *tbl[] = { "/detect", "/detect/batch", "/segment", "/stats", "/metrics", "/profile", "static", "other" };
+	return tbl[ep];
+}
+
+/*
+	metrics of an event loop, written only by its thread
+*/
+struct ThreadMetrics {
+	ldig::Counter requests[endpointN][4]; //!< by status 2xx, 3xx, 4xx, 5xx
+	ldig::Histogram latency[endpointN]; //!< of the requests except batch
+	ldig::Histogram stages[ldig::stageN];
+	ldig::Counter batchLines;
+	void count(int ep, int status)
+	{
+		requests[ep][std::min(3, std::max(0, status / 100 - 2))].add(1);
+	}
+	void record(const ldig::StageTimes& t)
+	{
+		for (int i = 0; i < ldig::stageN; i++) {
+			if (t.done & (1u << i)) stages[i].add(t.ns[i]);
+		}
+	}
+};
+
+/*
+	POST /detect/batch
+	one text per line of the body (plain text, JSON string or JSON object {"text": ..., "id": ...})
+	and one JSON per line of the response in the same order, written as they are detected.
+	the response is {"label", "prob"} (and "id" if given) or the same as /detect with explain.
+*/
+class BatchStream : public ldig::http::Stream {
+	const ldig::Detector& detector_;
+	ldig::Detector::Work& work_;
+	ThreadMetrics& metrics_;
+	bool explain_;
+	std::shared_ptr<const ldig::LabelSubset> subset_;
+	bool segment_;
+	double penalty_;
+	std::string line_; //!< incomplete line
+	bool tooLong_;
+	std::string text_;
+	std::string id_;
+	std::string json_;
+
+	static const size_t maxLineSize = 1024 * 1024;
+
+	void detect(std::string& out, std::string& line)
+	{
+		if (!line.empty() && line[line.size() - 1] == '\r') line.resize(line.size() - 1);
+		if (tooLong_) {
+			tooLong_ = false;
+			out += "{\"error\": \"too long\"}\n";
+			return;
+		}
+		if (line.empty()) return;
+		bool ok = true;
+		id_.clear();
+		if (line[0] == '{') {
+			ok = parseJsonObject(text_, id_, line);
+		} else if (line[0] == '"') {
+			size_t i = 0;
+			ok = parseJsonString(text_, line, i);
+		} else {
+			text_ = line;
+		}
+		out += '{';
+		if (!id_.empty()) {
+			out += "\"id\": ";
+			out += id_;
+			out += ", ";
+		}
+		if (!ok) {
+			out += "\"error\": \"bad json\"}\n";
+		} else if (segment_) {
+			detector_.segment(json_, work_, text_, penalty_);
+			out.append(json_, 1, std::string::npos);
+			out += '\n';
+		} else if (explain_) {
+			detector_.detect(json_, work_, text_, true, subset_.get());
+			out.append(json_, 1, std::string::npos);
+			out += '\n';
+		} else {
+			char buf[32];
+			const size_t k = detector_.predict(work_, text_, false, subset_.get());
+			out += "\"label\": ";
+			out += detector_.labelJson(k);
+			snprintf(buf, sizeof(buf), ", \"prob\": %0.3f}\n", work_.y[k]);
+			out += buf;
+			work_.times.lap(ldig::stageSerialize);
+		}
+		if (ok) {
+			metrics_.record(work_.times);
+			metrics_.batchLines.add(1);
+		}
+	}
+public:
+	BatchStream(const ldig::Detector& detector, ldig::Detector::Work& work, ThreadMetrics& metrics, bool explain, const std::shared_ptr<const ldig::LabelSubset>& subset, bool segment, double penalty)
+		: detector_(detector), work_(work), metrics_(metrics), explain_(explain), subset_(subset), segment_(segment), penalty_(penalty), tooLong_(false)
+	{
+	}
+	size_t write(std::string& out, const char *p, size_t n, size_t budget)
+	{
+		size_t i = 0;
+		while (i < n && out.size() < budget) {
+			const char *nl = (const char *)memchr(p + i, '\n', n - i);
+			const size_t e = nl ? nl - p : n;
+			if (!tooLong_) line_.append(p + i, e - i);
+			if (line_.size() > maxLineSize) {
+				line_.clear();
+				tooLong_ = true;
+			}
+			if (!nl) return n;
+			i = e + 1;
+			detect(out, line_);
+			line_.clear();
+		}
+		return i;
+	}
+	void finish(std::string& out)
+	{
+		if (!line_.empty() || tooLong_) detect(out, line_);
+	}
+};
+
+/* value of parameter is not "0", "false" nor "no" */
+bool isTrue(const ldig::http::Params& params, const char *name)
+{
+	ldig::http::Params::const_iterator i = params.find(name);
+	return i != params.end() && i->second != "0" && i->second != "false" && i->second != "no";
+}
+
+/*
+	sessions of /detect?session=..., the least recently used ones are removed
+	over the capacity or the bytes of their states
+	(a removed session which is in use is freed at the end of the request)
+*/
+class SessionStore {
+public:
+	struct Entry {
+		std::mutex mutex; //!< for a session used by requests at once
+		ldig::Session session;
+		std::list<std::string>::iterator lru;
+		size_t bytes; //!< bytes of session counted in the store (by mutex of the store)
+		bool removed;
+		explicit Entry(const ldig::Model& model) : session(model), bytes(0), removed(false) { }
+	};
+private:
+	const ldig::Model& model_;
+	size_t capacity_;
+	size_t maxBytes_;
+	size_t bytes_;
+	std::mutex mutex_;
+	std::unordered_map<std::string, std::shared_ptr<Entry> > map_;
+	std::list<std::string> lru_; //!< most recently used first
+
+	void removeLast()
+	{
+		std::unordered_map<std::string, std::shared_ptr<Entry> >::iterator i = map_.find(lru_.back());
+		bytes_ -= i->second->bytes;
+		i->second->removed = true;
+		map_.erase(i);
+		lru_.pop_back();
+	}
+public:
+	SessionStore(const ldig::Model& model, size_t capacity, size_t maxBytes)
+		: model_(model), capacity_(capacity), maxBytes_(maxBytes), bytes_(0) { }
+	std::shared_ptr<Entry> get(const std::string& id)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::shared_ptr<Entry>& entry = map_[id];
+		if (entry) {
+			lru_.splice(lru_.begin(), lru_, entry->lru);
+			return entry;
+		}
+		entry.reset(new Entry(model_));
+		lru_.push_front(id);
+		entry->lru = lru_.begin();
+		std::shared_ptr<Entry> ret = entry;
+		if (map_.size() > capacity_) removeLast();
+		return ret;
+	}
+	/**
+		count the bytes of the session after a request (with the lock of entry)
+	*/
+	void update(Entry& entry)
+	{
+		const size_t bytes = entry.session.bytes();
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (entry.removed) return;
+		bytes_ += bytes - entry.bytes;
+		entry.bytes = bytes;
+		while (bytes_ > maxBytes_ && !lru_.empty()) removeLast();
+	}
+	size_t size()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return map_.size();
+	}
+	size_t bytes()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return bytes_;
+	}
+};
+
+/* penalty of change of label for segmentation (not negative) */
+double getPenalty(const ldig::http::Params& params)
+{
+	ldig::http::Params::const_iterator i = params.find("penalty");
+	if (i == params.end()) return ldig::Segmenter::defaultPenalty();
+	return std::max(0.0, strtod(i->second.c_str(), 0));
+}
+
+class LdigHandler : public ldig::http::Handler {
+	const ldig::Detector& detector_;
+	ldig::ResultCache *cache_;
+	SessionStore *sessions_;
+	std::string staticDir_;
+	std::vector<ldig::Detector::Work> works_; //!< for each thread
+	std::vector<ThreadMetrics> metrics_; //!< for each thread
+	std::vector<std::unique_ptr<ldig::WalkProfile> > profiles_; //!< for each thread (empty if not profiled)
+	const ldig::http::Server *server_;
+	uint64_t startTime_;
+
+	/*
+		longer texts are detected without session
+		(a state keeps about (K + 8) x 8 bytes per character, 800KB for 4K characters with K = 17)
+	*/
+	static const size_t maxSessionText = 4 * 1024;
+
+	void notFound(ldig::http::Response& res, const std::string& path)
+	{
+		res.status = 404;
+		res.contentType = "text/plain";
+		res.headers.push_back(std::make_pair("Expires", "Fri, 31 Dec 2100 00:00:00 GMT"));
+		res.body = "Not Found : " + path;
+	}
+	void badRequest(ldig::http::Response& res, const std::string& message)
+	{
+		res.status = 400;
+		res.contentType = "text/plain";
+		res.body = message;
+	}
+	/*
+		subset of labels=xx,yy,...
+		@return false if a label is unknown
+	*/
+	bool getSubset(std::shared_ptr<const ldig::LabelSubset>& subset, std::string& message, const ldig::http::Params& params)
+	{
+		ldig::http::Params::const_iterator i = params.find("labels");
+		if (i == params.end()) return true;
+		try {
+			subset = detector_.subset(i->second);
+			return true;
+		} catch (cybozu::Exception& e) {
+			message = e.what();
+			return false;
+		}
+	}
+	void detect(ldig::http::Response& res, const ldig::http::Request& req, int thread)
+	{
+		ldig::http::Params params;
+		ldig::http::parseQuery(params, req.query);
+		ldig::http::Params::const_iterator i = params.find("text");
+		if (i == params.end()) {
+			badRequest(res, "need text");
+			return;
+		}
+		std::shared_ptr<const ldig::LabelSubset> subset;
+		std::string message;
+		if (!getSubset(subset, message, params)) {
+			badRequest(res, message);
+			return;
+		}
+		res.contentType = "application/json";
+		ldig::http::Params::const_iterator session = params.find("session");
+		if (sessions_ && session != params.end() && !subset && i->second.size() <= maxSessionText) {
+			std::shared_ptr<SessionStore::Entry> entry = sessions_->get(session->second);
+			std::lock_guard<std::mutex> lock(entry->mutex);
+			detector_.detect(res.body, works_[thread], entry->session, i->second, isTrue(params, "explain"));
+			sessions_->update(*entry);
+			metrics_[thread].record(works_[thread].times);
+			return;
+		}
+		detector_.detect(res.body, works_[thread], i->second, isTrue(params, "explain"), subset.get());
+		metrics_[thread].record(works_[thread].times);
+	}
+	void segment(ldig::http::Response& res, const ldig::http::Request& req, int thread)
+	{
+		ldig::http::Params params;
+		ldig::http::parseQuery(params, req.query);
+		ldig::http::Params::const_iterator i = params.find("text");
+		if (i == params.end()) {
+			badRequest(res, "need text");
+			return;
+		}
+		res.contentType = "application/json";
+		detector_.segment(res.body, works_[thread], i->second, getPenalty(params));
+		metrics_[thread].record(works_[thread].times);
+	}
+	/* {"cache": {"capacity", "size", "hits", "misses", "evictions", "hit_rate"}} */
+	void stats(ldig::http::Response& res)
+	{
+		res.contentType = "application/json";
+		res.body = "{\"cache\": ";
+		if (cache_) {
+			ldig::ResultCache::Stats st;
+			cache_->getStats(st);
+			char buf[256];
+			snprintf(buf, sizeof(buf), "{\"capacity\": %llu, \"size\": %llu, \"hits\": %llu, \"misses\": %llu, \"evictions\": %llu, \"hit_rate\": %.4f}",
+				(unsigned long long)st.capacity, (unsigned long long)st.size, (unsigned long long)st.hits,
+				(unsigned long long)st.misses, (unsigned long long)st.evictions, st.hitRate());
+			res.body += buf;
+		} else {
+			res.body += "null";
+		}
+		res.body += "}";
+	}
+	/* GET /metrics (text format of Prometheus) */
+	void metrics(ldig::http::Response& res)
+	{
+		static const char *codes[] = { "2xx", "3xx", "4xx", "5xx" };
+		const ldig::Model& model = detector_.model();
+		ldig::MetricsWriter w(res.body);
+		std::vector<const ldig::Histogram*> hs;
+		std::string labels;
+		char buf[256];
+
+		w.header("ldigd_requests_total", "counter", "Requests by path and status.");
+		for (int ep = 0; ep < endpointN; ep++) {
+			for (int c = 0; c < 4; c++) {
+				uint64_t n = 0;
+				for (size_t t = 0; t < metrics_.size(); t++) n += metrics_[t].requests[ep][c].get();
+				snprintf(buf, sizeof(buf), "path=\"%s\",code=\"%s\"", endpointName(ep), codes[c]);
+				w.value("ldigd_requests_total", buf, (double)n);
+			}
+		}
+		w.header("ldigd_request_duration_seconds", "histogram", "Time to handle requests except /detect/batch.");
+		for (int ep = 0; ep < endpointN; ep++) {
+			if (ep == epBatch) continue;
+			hs.clear();
+			for (size_t t = 0; t < metrics_.size(); t++) hs.push_back(&metrics_[t].latency[ep]);
+			snprintf(buf, sizeof(buf), "path=\"%s\"", endpointName(ep));
+			w.histogram("ldigd_request_duration_seconds", buf, hs);
+		}
+		w.header("ldig_stage_duration_seconds", "histogram", "Time of the stages of a detection (a text of /detect, /segment or a line of /detect/batch).");
+		for (int i = 0; i < ldig::stageN; i++) {
+			hs.clear();
+			for (size_t t = 0; t < metrics_.size(); t++) hs.push_back(&metrics_[t].stages[i]);
+			snprintf(buf, sizeof(buf), "stage=\"%s\"", ldig::stageName(i));
+			w.histogram("ldig_stage_duration_seconds", buf, hs);
+		}
+		uint64_t lines = 0;
+		for (size_t t = 0; t < metrics_.size(); t++) lines += metrics_[t].batchLines.get();
+		w.header("ldigd_batch_lines_total", "counter", "Lines detected in /detect/batch.");
+		w.value("ldigd_batch_lines_total", "", (double)lines);
+
+		if (server_) {
+			static const char *gauges[][2] = {
+				{ "ldigd_connections", "Open connections of each event loop." },
+				{ "ldigd_blocked_connections", "Connections whose requests are not read while their responses are pending." },
+				{ "ldigd_ready_events", "Events of the last epoll_wait of each event loop." },
+			};
+			for (int g = 0; g < 3; g++) {
+				w.header(gauges[g][0], "gauge", gauges[g][1]);
+				for (int t = 0; t < server_->threads(); t++) {
+					const ldig::http::LoopStats& st = server_->loopStats(t);
+					const int v = g == 0 ? st.connections.load(std::memory_order_relaxed)
+						: g == 1 ? st.blocked.load(std::memory_order_relaxed) : st.ready.load(std::memory_order_relaxed);
+					snprintf(buf, sizeof(buf), "thread=\"%d\"", t);
+					w.value(gauges[g][0], buf, v);
+				}
+			}
+		}
+		if (cache_) {
+			ldig::ResultCache::Stats st;
+			cache_->getStats(st);
+			w.header("ldig_cache_hits_total", "counter", "Hits of the result cache.");
+			w.value("ldig_cache_hits_total", "", (double)st.hits);
+			w.header("ldig_cache_misses_total", "counter", "Misses of the result cache.");
+			w.value("ldig_cache_misses_total", "", (double)st.misses);
+			w.header("ldig_cache_evictions_total", "counter", "Evictions of the result cache.");
+			w.value("ldig_cache_evictions_total", "", (double)st.evictions);
+			w.header("ldig_cache_entries", "gauge", "Entries of the result cache.");
+			w.value("ldig_cache_entries", "", (double)st.size);
+			w.header("ldig_cache_hit_ratio", "gauge", "Hits / lookups of the result cache since the start.");
+			w.value("ldig_cache_hit_ratio", "", st.hitRate());
+		}
+		if (sessions_) {
+			w.header("ldigd_sessions", "gauge", "Sessions of incremental detection.");
+			w.value("ldigd_sessions", "", (double)sessions_->size());
+			w.header("ldigd_session_bytes", "gauge", "Bytes of the states of the sessions.");
+			w.value("ldigd_session_bytes", "", (double)sessions_->bytes());
+		}
+		w.header("ldig_model_info", "gauge", "Model loaded (version is the hash of the trie and the labels).");
+		labels = "dir=\"";
+		for (size_t i = 0; i < model.dir().size(); i++) {
+			const char c = model.dir()[i];
+			if (c == '\\' || c == '"') labels += '\\';
+			if (c == '\n') {
+				labels += "\\n";
+			} else {
+				labels += c;
+			}
+		}
+		snprintf(buf, sizeof(buf), "\",version=\"%016llx\",labels=\"%d\",features=\"%d\"",
+			(unsigned long long)model.trieHash, (int)model.K, (int)model.M);
+		labels += buf;
+		w.value("ldig_model_info", labels, 1);
+		w.header("ldigd_start_time_seconds", "gauge", "Start time of the server since the epoch.");
+		w.value("ldigd_start_time_seconds", "", (double)startTime_);
+		res.contentType = "text/plain; version=0.0.4";
+	}
+	/* GET /profile (.npz of ldig::Profile) */
+	void profile(ldig::http::Response& res)
+	{
+		if (profiles_.empty()) {
+			notFound(res, "/profile (run with --profile)");
+			return;
+		}
+		ldig::Profile profile;
+		profile.trieHash = detector_.model().trieHash;
+		for (size_t t = 0; t < profiles_.size(); t++) profile.add(*profiles_[t]);
+		profile.encode(res.body);
+		res.contentType = "application/octet-stream";
+	}
+	void sendFile(ldig::http::Response& res, std::string path)
+	{
+		if (path.find("..") != std::string::npos) {
+			notFound(res, path);
+			return;
+		}
+		if (path[path.size() - 1] == '/') path += "index.html";
+		std::ifstream ifs((staticDir_ + path).c_str(), std::ios::binary);
+		if (!ifs) {
+			notFound(res, path);
+			return;
+		}
+		res.body.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".html") == 0) {
+			res.contentType = "text/html; charset=utf-8";
+		} else if (path.size() >= 3 && path.compare(path.size() - 3, 3, ".js") == 0) {
+			res.contentType = "text/javascript; charset=utf-8";
+		}
+	}
+public:
+	LdigHandler(const ldig::Detector& detector, ldig::ResultCache *cache, SessionStore *sessions, const std::string& staticDir, int threads)
+		: detector_(detector), cache_(cache), sessions_(sessions), staticDir_(staticDir), works_(threads), metrics_(threads)
+		, server_(0), startTime_(time(0))
+	{
+	}
+	/**
+		server of the handler for the state of the event loops in /metrics
+	*/
+	void setServer(const ldig::http::Server *server) { server_ = server; }
+	/**
+		count the features and the trie walks of the detections for /profile
+	*/
+	void enableProfile()
+	{
+		profiles_.resize(works_.size());
+		for (size_t t = 0; t < works_.size(); t++) {
+			profiles_[t].reset(new ldig::WalkProfile(detector_.model().M));
+			works_[t].profile = profiles_[t].get();
+		}
+	}
+	ldig::http::Stream *openStream(ldig::http::Response& res, const ldig::http::Request& req, int thread)
+	{
+		if (req.method != "POST" || req.path != "/detect/batch") return 0;
+		ldig::http::Params params;
+		ldig::http::parseQuery(params, req.query);
+		std::shared_ptr<const ldig::LabelSubset> subset;
+		std::string message;
+		/* handle() answers the error */
+		if (!getSubset(subset, message, params)) return 0;
+		res.contentType = "application/x-ndjson";
+		metrics_[thread].count(epBatch, 200);
+		return new BatchStream(detector_, works_[thread], metrics_[thread], isTrue(params, "explain"), subset, isTrue(params, "segment"), getPenalty(params));
+	}
+	void handle(ldig::http::Response& res, const ldig::http::Request& req, int thread)
+	{
+		const uint64_t begin = ldig::nowNs();
+		const int ep = dispatch(res, req, thread);
+		ThreadMetrics& m = metrics_[thread];
+		m.count(ep, res.status);
+		m.latency[ep].add(ldig::nowNs() - begin);
+	}
+private:
+	/* @return endpoint of the request */
+	int dispatch(ldig::http::Response& res, const ldig::http::Request& req, int thread)
+	{
+		if (req.method == "POST" && req.path == "/detect/batch") {
+			ldig::http::Params params;
+			ldig::http::parseQuery(params, req.query);
+			std::shared_ptr<const ldig::LabelSubset> subset;
+			std::string message;
+			getSubset(subset, message, params);
+			badRequest(res, message);
+			return epBatch;
+		} else if (req.method != "GET") {
+			res.status = 501;
+			res.contentType = "text/plain";
+			res.body = "Unsupported method : " + req.method;
+		} else if (req.path == "/detect") {
+			detect(res, req, thread);
+			return epDetect;
+		} else if (req.path == "/segment") {
+			segment(res, req, thread);
+			return epSegment;
+		} else if (req.path == "/stats") {
+			stats(res);
+			return epStats;
+		} else if (req.path == "/metrics") {
+			metrics(res);
+			return epMetrics;
+		} else if (req.path == "/profile") {
+			profile(res);
+			return epProfile;
+		} else if (!req.path.empty() && req.path[0] == '/') {
+			sendFile(res, req.path);
+			return epStatic;
+		} else {
+			notFound(res, req.path);
+		}
+		return epOther;
+	}
+};
+
+int main(int argc, char *argv[])
+	try
+{
+	Options opt;
+	parseOptions(opt, argc, argv);
+
+	ldig::Model model;
+	model.load(opt.model);
+	ldig::Detector detector(model);
+	std::unique_ptr<ldig::ResultCache> cache(opt.cacheSize > 0 ? new ldig::ResultCache(opt.cacheSize, model.K) : 0);
+	detector.setCache(cache.get());
+	std::unique_ptr<ldig::EarlyExit> early(opt.earlyExit ? new ldig::EarlyExit(model) : 0);
+	detector.setEarlyExit(early.get());
+	std::unique_ptr<SessionStore> sessions(opt.sessions > 0 ? new SessionStore(model, opt.sessions, opt.sessionMemory << 20) : 0);
+	LdigHandler handler(detector, cache.get(), sessions.get(), opt.staticDir, opt.http.threads);
+	ldig::http::Server server(opt.http, handler);
+	handler.setServer(&server);
+	if (opt.profile) handler.enableProfile();
+	printf("ready. (port = %d, threads = %d)\n", opt.http.port, opt.http.threads);
+	fflush(stdout);
+	server.run();
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "ERR:" << e.what() << std::endl;
+	return 1;
+}
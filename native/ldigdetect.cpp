@@ -0,0 +1,358 @@
+/**
+	@file
+	@brief language detector for pipes (native version of ldig.likelihood)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include "model.hpp"
+#include "corpus.hpp"
+#include "queue.hpp"
+#include "cache.hpp"
+#include "earlyexit.hpp"
+#include "profile.hpp"
+
+const double acceptThreshold = 0.6; // same as ldig.likelihood
+const size_t batchSize = 1024;      // lines
+
+struct Options {
+	std::string model;
+	int threads;
+	size_t cacheSize;
+	bool earlyExit;
+	std::string profile;
+	bool normalize;
+	std::vector<std::string> files;
+	Options() : threads((int)std::max(1u, std::thread::hardware_concurrency())), cacheSize(0), earlyExit(false), normalize(false) { }
+};
+
+void usage()
+{
+	std::cerr << "usage: ldigdetect -m [model directory] [-t threads] [-c cache entries] [--early-exit] [--profile profile.npz] [files (default: stdin)]" << std::endl;
+	std::cerr << "       ldigdetect --normalize [files (default: stdin)]" << std::endl;
+	exit(1);
+}
+
+void parseOptions(Options& opt, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const std::string a = argv[i];
+		if (i + 1 < argc && a == "-m") {
+			opt.model = argv[++i];
+		} else if (i + 1 < argc && a == "-t") {
+			opt.threads = std::max(1, atoi(argv[++i]));
+		} else if (i + 1 < argc && a == "-c") {
+			opt.cacheSize = strtoul(argv[++i], 0, 10);
+		} else if (a == "--early-exit") {
+			opt.earlyExit = true;
+		} else if (i + 1 < argc && a == "--profile") {
+			opt.profile = argv[++i];
+		} else if (a == "--normalize") {
+			opt.normalize = true;
+		} else if (a[0] == '-' && a != "-") {
+			usage();
+		} else {
+			opt.files.push_back(a);
+		}
+	}
+	if (opt.model.empty() && !opt.normalize) usage();
+	if (opt.earlyExit && !opt.profile.empty()) {
+		/* early exit scans a part of the text without extraction, which the profile can't count */
+		std::cerr << "ldigdetect: --early-exit and --profile can't be used together" << std::endl;
+		exit(1);
+	}
+	if (opt.files.empty()) opt.files.push_back("-");
+}
+
+/*
+	output [label]\t[normalized text] of each line (ldig.normalize_text)
+*/
+void normalize(const std::vector<std::string>& files)
+{
+	std::string line, label, org, out;
+	cybozu::String text;
+	for (size_t f = 0; f < files.size(); f++) {
+		ldig::LineReader reader(files[f]);
+		while (reader.getline(line)) {
+			ldig::normalizeText(label, text, org, line, reader.hasNewline());
+			out.clear();
+			text.toUtf8(out);
+			printf("%s\t%s\n", label.c_str(), out.c_str());
+		}
+	}
+}
+
+/*
+	lines read at once, which go through reader -> worker -> writer
+*/
+struct Batch {
+	size_t seq;
+	size_t file;
+	size_t firstLine; //!< line number of lines[0] in file (0 origin)
+	std::vector<std::string> lines;
+	std::vector<char> newlines; //!< the line ends with '\n'
+	size_t n;
+	std::string out;
+	/* statistics */
+	std::vector<int> counts;
+	std::vector<int> corrects;
+	double logLikely;
+	std::vector<std::pair<size_t, std::string> > unknowns; //!< (index of line, label) not in model
+	size_t scanned; //!< characters scanned with early exit
+	size_t chars;
+
+	explicit Batch(size_t K) : seq(0), file(0), firstLine(0), lines(batchSize), newlines(batchSize), n(0), counts(K), corrects(K), logLikely(0), scanned(0), chars(0) { }
+	void clear()
+	{
+		n = 0;
+		out.clear();
+		std::fill(counts.begin(), counts.end(), 0);
+		std::fill(corrects.begin(), corrects.end(), 0);
+		logLikely = 0;
+		unknowns.clear();
+		scanned = chars = 0;
+	}
+};
+
+typedef ldig::BoundedQueue<Batch*> Queue;
+
+/*
+	normalize, extract features and score the lines of batches
+*/
+void work(Queue *input, Queue *output, const ldig::Model *model, ldig::ResultCache *cache, const ldig::EarlyExit *early, ldig::WalkProfile *profile)
+{
+	std::string label, org;
+	cybozu::String text, buf;
+	std::vector<int> ids;
+	ldig::Events events;
+	std::vector<double> y(model->K), rest;
+	for (;;) {
+		Batch *b = input->pop();
+		if (b == 0) break;
+		for (size_t i = 0; i < b->n; i++) {
+			ldig::normalizeText(label, text, org, b->lines[i], b->newlines[i] != 0);
+			const uint64_t key = cache ? ldig::hashText(text) : 0;
+			if (!cache || !cache->get(key, &y[0])) {
+				if (early) {
+					b->scanned += early->predict(&y[0], rest, buf, text);
+					b->chars += buf.size();
+				} else if (profile) {
+					model->extract(events, ids, buf, text, *profile);
+					profile->endText(events);
+					model->predict(&y[0], events);
+				} else {
+					model->extract(events, ids, buf, text);
+					model->predict(&y[0], events);
+				}
+				if (cache) cache->put(key, &y[0]);
+			}
+			const size_t k = std::max_element(y.begin(), y.end()) - y.begin();
+			const int labelK = model->labelIndex(label);
+			if (labelK >= 0) {
+				b->logLikely -= std::log(y[labelK]);
+				b->counts[labelK]++;
+				if (labelK == (int)k && y[k] >= acceptThreshold) b->corrects[k]++;
+			} else {
+				b->unknowns.push_back(std::make_pair(i, label));
+			}
+			/* print "%s\t%s\t%s" % (label, predict_lang, org_text) */
+			b->out += label;
+			b->out += '\t';
+			if (y[k] >= acceptThreshold) b->out += model->labels[k];
+			b->out += '\t';
+			b->out += org;
+			/* org_text of a line without label keeps its '\n' */
+			if (label.empty() && b->newlines[i]) b->out += '\n';
+			b->out += '\n';
+		}
+		output->push(b);
+	}
+	output->push(0);
+}
+
+/*
+	write the batches in the order of input
+*/
+struct Writer {
+	const ldig::Model& model;
+	const std::vector<std::string>& files;
+	std::vector<int> counts;
+	std::vector<int> corrects;
+	double logLikely;
+	std::set<std::string> warned;
+	uint64_t scanned;
+	uint64_t chars;
+
+	Writer(const ldig::Model& model, const std::vector<std::string>& files)
+		: model(model), files(files), counts(model.K), corrects(model.K), logLikely(0), scanned(0), chars(0)
+	{
+	}
+	void write(const Batch& b)
+	{
+		fwrite(b.out.data(), 1, b.out.size(), stdout);
+		for (size_t k = 0; k < model.K; k++) {
+			counts[k] += b.counts[k];
+			corrects[k] += b.corrects[k];
+		}
+		logLikely += b.logLikely;
+		scanned += b.scanned;
+		chars += b.chars;
+		for (size_t i = 0; i < b.unknowns.size(); i++) {
+			const std::string& label = b.unknowns[i].second;
+			if (!warned.insert(label).second) continue;
+			fprintf(stderr, "WARNING : unknown label '%s' at %d in %s (ignore the later same labels)\n",
+				label.c_str(), (int)(b.firstLine + b.unknowns[i].first + 1), files[b.file].c_str());
+		}
+	}
+	void run(Queue *done, Queue *free, int workers)
+	{
+		std::map<size_t, Batch*> reorder;
+		size_t next = 0;
+		while (workers > 0) {
+			Batch *b = done->pop();
+			if (b == 0) {
+				workers--;
+				continue;
+			}
+			reorder[b->seq] = b;
+			for (std::map<size_t, Batch*>::iterator i = reorder.begin(); i != reorder.end() && i->first == next; i = reorder.begin()) {
+				write(*i->second);
+				i->second->clear();
+				free->push(i->second);
+				reorder.erase(i);
+				next++;
+			}
+		}
+	}
+	void printSummary() const
+	{
+		int total = 0, correct = 0;
+		for (size_t k = 0; k < model.K; k++) {
+			total += counts[k];
+			correct += corrects[k];
+		}
+		if (total == 0) return;
+		for (size_t k = 0; k < model.K; k++) {
+			if (counts[k] > 0) printf(">    %s = %d / %d = %.2f\n", model.labels[k].c_str(), corrects[k], counts[k], 100.0 * corrects[k] / counts[k]);
+		}
+		printf("> total = %d / %d = %.2f\n", correct, total, 100.0 * correct / total);
+		printf("> average negative log likelihood = %.3f\n", logLikely / total);
+	}
+};
+
+void runWriter(Writer *writer, Queue *done, Queue *free, int workers)
+{
+	writer->run(done, free, workers);
+}
+
+int main(int argc, char *argv[])
+	try
+{
+	Options opt;
+	parseOptions(opt, argc, argv);
+	if (opt.normalize) {
+		normalize(opt.files);
+		return 0;
+	}
+
+	ldig::Model model;
+	model.load(opt.model);
+	std::unique_ptr<ldig::ResultCache> cache(opt.cacheSize > 0 ? new ldig::ResultCache(opt.cacheSize, model.K) : 0);
+	std::unique_ptr<ldig::EarlyExit> early(opt.earlyExit ? new ldig::EarlyExit(model, acceptThreshold) : 0);
+
+	static char outbuf[1 << 20];
+	setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+
+	/*
+		the batches circulate through free -> reader -> input -> workers -> done -> writer -> free,
+		so the memory is bounded by the number of batches
+	*/
+	const size_t nBatches = opt.threads * 4;
+	std::vector<Batch> batches(nBatches, Batch(model.K));
+	Queue free(nBatches), input(nBatches), done(nBatches + opt.threads);
+	for (size_t i = 0; i < nBatches; i++) free.push(&batches[i]);
+
+	Writer writer(model, opt.files);
+	std::vector<std::unique_ptr<ldig::WalkProfile> > profiles(opt.threads);
+	if (!opt.profile.empty()) {
+		for (int i = 0; i < opt.threads; i++) profiles[i].reset(new ldig::WalkProfile(model.M));
+	}
+	std::vector<std::thread> threads;
+	for (int i = 0; i < opt.threads; i++) threads.push_back(std::thread(work, &input, &done, &model, cache.get(), early.get(), profiles[i].get()));
+	std::thread writerThread(runWriter, &writer, &done, &free, opt.threads);
+
+	size_t seq = 0;
+	try {
+		for (size_t f = 0; f < opt.files.size(); f++) {
+			ldig::LineReader reader(opt.files[f]);
+			size_t lineNo = 0;
+			for (bool eof = false; !eof; ) {
+				Batch *b = free.pop();
+				b->seq = seq++;
+				b->file = f;
+				b->firstLine = lineNo;
+				try {
+					while (b->n < batchSize) {
+						if (!reader.getline(b->lines[b->n])) {
+							eof = true;
+							break;
+						}
+						b->newlines[b->n] = reader.hasNewline();
+						b->n++;
+					}
+				} catch (...) {
+					input.push(b); // the lines before the error
+					throw;
+				}
+				lineNo += b->n;
+				input.push(b);
+			}
+		}
+	} catch (...) {
+		/* stop the threads before the error is reported */
+		for (int i = 0; i < opt.threads; i++) input.push(0);
+		for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+		writerThread.join();
+		fflush(stdout);
+		throw;
+	}
+	for (int i = 0; i < opt.threads; i++) input.push(0);
+	for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+	writerThread.join();
+
+	writer.printSummary();
+	fflush(stdout);
+	if (cache.get()) {
+		ldig::ResultCache::Stats st;
+		cache->getStats(st);
+		fprintf(stderr, "> cache : hits = %llu / %llu = %.2f%%, entries = %llu / %llu, evictions = %llu\n",
+			(unsigned long long)st.hits, (unsigned long long)(st.hits + st.misses), 100.0 * st.hitRate(),
+			(unsigned long long)st.size, (unsigned long long)st.capacity, (unsigned long long)st.evictions);
+	}
+	if (early.get() && writer.chars > 0) {
+		fprintf(stderr, "> early exit : scanned = %llu / %llu = %.2f%% characters\n",
+			(unsigned long long)writer.scanned, (unsigned long long)writer.chars, 100.0 * writer.scanned / writer.chars);
+	}
+	if (!opt.profile.empty()) {
+		ldig::Profile profile;
+		profile.trieHash = model.trieHash;
+		for (int i = 0; i < opt.threads; i++) profile.add(*profiles[i]);
+		profile.save(opt.profile);
+		fprintf(stderr, "> profile : %llu texts => %s\n", (unsigned long long)profile.texts(), opt.profile.c_str());
+	}
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "ERR:" << e.what() << std::endl;
+	return 1;
+}
@@ -0,0 +1,233 @@
+/**
+	@file
+	@brief evaluator of ldig model (native version of ldig.likelihood with confusion matrix)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "model.hpp"
+#include "corpus.hpp"
+#include "json.hpp"
+
+const double acceptThreshold = 0.6; // same as ldig.likelihood
+const int sweepSteps = 20;          // thresholds 0.00, 0.05, ..., 0.95
+
+struct Options {
+	std::string model;
+	std::string report;
+	int threads;
+	bool useCache;
+	std::vector<std::string> files;
+	Options() : threads((int)std::max(1u, std::thread::hardware_concurrency())), useCache(true) { }
+};
+
+void usage()
+{
+	std::cerr << "usage: ldigeval -m [model directory] [-t threads] [-o report.json] [--no-cache] [test files]" << std::endl;
+	exit(1);
+}
+
+void parseOptions(Options& opt, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const std::string a = argv[i];
+		if (i + 1 < argc && a == "-m") {
+			opt.model = argv[++i];
+		} else if (i + 1 < argc && a == "-o") {
+			opt.report = argv[++i];
+		} else if (i + 1 < argc && a == "-t") {
+			opt.threads = std::max(1, atoi(argv[++i]));
+		} else if (a == "--no-cache") {
+			opt.useCache = false;
+		} else if (a[0] == '-' && a != "-") {
+			usage();
+		} else {
+			opt.files.push_back(a);
+		}
+	}
+	if (opt.model.empty() || opt.files.empty()) usage();
+}
+
+/*
+	counters of evaluation, reduced over threads
+*/
+struct Counter {
+	size_t K;
+	size_t unknown;        //!< texts with unknown label
+	double logLikely;      //!< sum of negative log likelihood
+	std::vector<int> counts;    //!< [correct label]
+	std::vector<int> corrects;  //!< [correct label], predicted with prob >= acceptThreshold
+	std::vector<int> confusion; //!< [correct label][argmax label]
+	std::vector<int> predicted; //!< [threshold][label], argmax with prob >= threshold
+	std::vector<int> truePositive; //!< [threshold][label]
+
+	explicit Counter(size_t K)
+		: K(K), unknown(0), logLikely(0), counts(K), corrects(K), confusion(K * K)
+		, predicted(sweepSteps * K), truePositive(sweepSteps * K)
+	{
+	}
+	void add(int label, const double *y)
+	{
+		const int predict = (int)(std::max_element(y, y + K) - y);
+		if (label < 0) {
+			unknown++;
+			return;
+		}
+		logLikely -= std::log(y[label]);
+		counts[label]++;
+		if (label == predict && y[predict] >= acceptThreshold) corrects[label]++;
+		confusion[label * K + predict]++;
+		for (int t = 0; t < sweepSteps && y[predict] >= threshold(t); t++) {
+			predicted[t * K + predict]++;
+			if (label == predict) truePositive[t * K + predict]++;
+		}
+	}
+	void merge(const Counter& rhs)
+	{
+		unknown += rhs.unknown;
+		logLikely += rhs.logLikely;
+		for (size_t i = 0; i < counts.size(); i++) counts[i] += rhs.counts[i];
+		for (size_t i = 0; i < corrects.size(); i++) corrects[i] += rhs.corrects[i];
+		for (size_t i = 0; i < confusion.size(); i++) confusion[i] += rhs.confusion[i];
+		for (size_t i = 0; i < predicted.size(); i++) predicted[i] += rhs.predicted[i];
+		for (size_t i = 0; i < truePositive.size(); i++) truePositive[i] += rhs.truePositive[i];
+	}
+	static double threshold(int t) { return t * (1.0 / sweepSteps); }
+};
+
+void evaluate(Counter *counter, const ldig::Model *model, const ldig::FeaturizedCorpus *corpus, size_t begin, size_t end)
+{
+	std::vector<double> y(model->K);
+	for (size_t i = begin; i < end; i++) {
+		model->predict(&y[0], corpus->events(i), corpus->length(i));
+		counter->add(corpus->label(i), &y[0]);
+	}
+}
+
+inline double ratio(int a, int b) { return b > 0 ? (double)a / b : 0; }
+
+void printSummary(const Counter& c, const ldig::Model& model)
+{
+	const size_t K = model.K;
+	int total = 0, corrects = 0;
+	for (size_t k = 0; k < K; k++) {
+		total += c.counts[k];
+		corrects += c.corrects[k];
+		if (c.counts[k] > 0) {
+			printf(">    %s = %d / %d = %.2f\n", model.labels[k].c_str(), c.corrects[k], c.counts[k], 100.0 * c.corrects[k] / c.counts[k]);
+		}
+	}
+	if (c.unknown > 0) printf("> WARNING : %d texts with unknown label are ignored\n", (int)c.unknown);
+	if (total == 0) return;
+	printf("> total = %d / %d = %.2f\n", corrects, total, 100.0 * corrects / total);
+	printf("> average negative log likelihood = %.3f\n", c.logLikely / total);
+
+	printf("> confusion matrix (row = correct, column = detected)\n>     ");
+	for (size_t j = 0; j < K; j++) printf("\t%s", model.labels[j].c_str());
+	printf("\n");
+	for (size_t i = 0; i < K; i++) {
+		if (c.counts[i] == 0) continue;
+		printf(">    %s", model.labels[i].c_str());
+		for (size_t j = 0; j < K; j++) printf("\t%d", c.confusion[i * K + j]);
+		printf("\n");
+	}
+}
+
+void writeReport(const std::string& path, const Counter& c, const ldig::Model& model, double elapsed)
+{
+	const size_t K = model.K;
+	std::ofstream ofs(path.c_str());
+	if (!ofs) {
+		cybozu::Exception e("ldigeval");
+		e << "can't open" << path;
+		throw e;
+	}
+	int total = 0, corrects = 0;
+	for (size_t k = 0; k < K; k++) {
+		total += c.counts[k];
+		corrects += c.corrects[k];
+	}
+	std::vector<std::string> labels(K); // JSON strings
+	for (size_t k = 0; k < K; k++) ldig::appendJsonString(labels[k], model.labels[k]);
+	char buf[256];
+	ofs << "{\n  \"labels\": [";
+	for (size_t k = 0; k < K; k++) ofs << (k ? ", " : "") << labels[k];
+	ofs << "],\n";
+	snprintf(buf, sizeof(buf), "  \"texts\": %d,\n  \"unknown_label_texts\": %d,\n  \"threshold\": %.2f,\n  \"correct\": %d,\n  \"accuracy\": %.6f,\n  \"average_negative_log_likelihood\": %.6f,\n  \"elapsed_sec\": %.3f,\n",
+		total, (int)c.unknown, acceptThreshold, corrects, ratio(corrects, total), total ? c.logLikely / total : 0.0, elapsed);
+	ofs << buf;
+	ofs << "  \"per_label\": {";
+	for (size_t k = 0; k < K; k++) {
+		snprintf(buf, sizeof(buf), ": {\"count\": %d, \"correct\": %d, \"accuracy\": %.6f}",
+			c.counts[k], c.corrects[k], ratio(c.corrects[k], c.counts[k]));
+		ofs << (k ? ",\n    " : "\n    ") << labels[k] << buf;
+	}
+	ofs << "\n  },\n  \"confusion_matrix\": [";
+	for (size_t i = 0; i < K; i++) {
+		ofs << (i ? ",\n    [" : "\n    [");
+		for (size_t j = 0; j < K; j++) ofs << (j ? ", " : "") << c.confusion[i * K + j];
+		ofs << "]";
+	}
+	ofs << "\n  ],\n  \"threshold_sweep\": [";
+	for (int t = 0; t < sweepSteps; t++) {
+		int tp = 0, pred = 0;
+		snprintf(buf, sizeof(buf), "%s\n    {\"threshold\": %.2f, \"precision\": [", t ? "," : "", Counter::threshold(t));
+		ofs << buf;
+		for (size_t k = 0; k < K; k++) {
+			tp += c.truePositive[t * K + k];
+			pred += c.predicted[t * K + k];
+			snprintf(buf, sizeof(buf), "%s%.6f", k ? ", " : "", ratio(c.truePositive[t * K + k], c.predicted[t * K + k]));
+			ofs << buf;
+		}
+		ofs << "], \"recall\": [";
+		for (size_t k = 0; k < K; k++) {
+			snprintf(buf, sizeof(buf), "%s%.6f", k ? ", " : "", ratio(c.truePositive[t * K + k], c.counts[k]));
+			ofs << buf;
+		}
+		snprintf(buf, sizeof(buf), "], \"micro_precision\": %.6f, \"micro_recall\": %.6f}", ratio(tp, pred), ratio(tp, total));
+		ofs << buf;
+	}
+	ofs << "\n  ]\n}\n";
+}
+
+int main(int argc, char *argv[])
+	try
+{
+	Options opt;
+	parseOptions(opt, argc, argv);
+
+	ldig::Model model;
+	model.load(opt.model);
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ldig::FeaturizedCorpus corpus;
+	for (size_t i = 0; i < opt.files.size(); i++) corpus.add(opt.files[i], model, opt.useCache, opt.threads);
+
+	const size_t N = corpus.size();
+	std::vector<Counter> counters(opt.threads, Counter(model.K));
+	std::vector<std::thread> threads;
+	for (int t = 1; t < opt.threads; t++) {
+		threads.push_back(std::thread(evaluate, &counters[t], &model, &corpus, N * t / opt.threads, N * (t + 1) / opt.threads));
+	}
+	evaluate(&counters[0], &model, &corpus, 0, N / opt.threads);
+	for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+	for (int t = 1; t < opt.threads; t++) counters[0].merge(counters[t]);
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printSummary(counters[0], model);
+	if (!opt.report.empty()) writeReport(opt.report, counters[0], model, elapsed);
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "ERR:" << e.what() << std::endl;
+	return 1;
+}
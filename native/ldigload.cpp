@@ -0,0 +1,254 @@
+/**
+	@file
+	@brief load test of ldig server (/detect) for throughput and latency
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "corpus.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+	std::string host;
+	std::string port;
+	int connections;
+	double duration;
+	bool keepAlive;
+	bool explain;
+	std::vector<std::string> files;
+	Options() : host("127.0.0.1"), port("48000"), connections(8), duration(10), keepAlive(true), explain(false) { }
+};
+
+void usage()
+{
+	std::cerr << "usage: ldigload [-h host] [-p port] [-c connections] [-d seconds] [--close] [--explain] [text files]" << std::endl;
+	exit(1);
+}
+
+void parseOptions(Options& opt, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const std::string a = argv[i];
+		if (i + 1 < argc && a == "-h") {
+			opt.host = argv[++i];
+		} else if (i + 1 < argc && a == "-p") {
+			opt.port = argv[++i];
+		} else if (i + 1 < argc && a == "-c") {
+			opt.connections = std::max(1, atoi(argv[++i]));
+		} else if (i + 1 < argc && a == "-d") {
+			opt.duration = atof(argv[++i]);
+		} else if (a == "--close") {
+			opt.keepAlive = false;
+		} else if (a == "--explain") {
+			opt.explain = true;
+		} else if (a[0] == '-' && a != "-") {
+			usage();
+		} else {
+			opt.files.push_back(a);
+		}
+	}
+	if (opt.files.empty()) usage();
+}
+
+/* same as encodeURIComponent of JavaScript */
+std::string encodeURIComponent(const std::string& s)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	std::string out;
+	for (size_t i = 0; i < s.size(); i++) {
+		const unsigned char c = s[i];
+		if (isalnum(c) || strchr("-_.!~*'()", c)) {
+			out += c;
+		} else {
+			out += '%';
+			out += hex[c >> 4];
+			out += hex[c & 15];
+		}
+	}
+	return out;
+}
+
+class Client {
+	const Options& opt_;
+	const addrinfo *addr_;
+	int fd_;
+	std::string buf_;
+
+	bool connect()
+	{
+		fd_ = socket(addr_->ai_family, addr_->ai_socktype, addr_->ai_protocol);
+		if (fd_ < 0) return false;
+		if (::connect(fd_, addr_->ai_addr, addr_->ai_addrlen) < 0) {
+			disconnect();
+			return false;
+		}
+		const int one = 1;
+		setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		buf_.clear();
+		return true;
+	}
+	void disconnect()
+	{
+		if (fd_ >= 0) close(fd_);
+		fd_ = -1;
+	}
+	bool fill()
+	{
+		char buf[65536];
+		const ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+		if (n <= 0) return false;
+		buf_.append(buf, n);
+		return true;
+	}
+	/*
+		read one response
+		without Content-Length, the response ends at the close of connection (as server.py)
+	*/
+	bool readResponse(int& status)
+	{
+		size_t end;
+		while ((end = buf_.find("\r\n\r\n")) == std::string::npos) {
+			if (!fill()) {
+				/* server.py writes /detect result without status line and closes */
+				const bool ok = !buf_.empty();
+				status = ok ? 200 : -1;
+				buf_.clear();
+				disconnect();
+				return ok;
+			}
+		}
+		status = strncmp(buf_.c_str(), "HTTP/", 5) == 0 ? atoi(buf_.c_str() + 9) : 200;
+		std::string header = buf_.substr(0, end);
+		for (size_t i = 0; i < header.size(); i++) header[i] = (char)tolower((unsigned char)header[i]);
+		const size_t cl = header.find("\ncontent-length:");
+		bool close = header.find("\nconnection: close") != std::string::npos || header.compare(0, 8, "http/1.0") == 0;
+		if (cl == std::string::npos) {
+			while (fill()) { }
+			buf_.clear();
+			disconnect();
+			return true;
+		}
+		const size_t len = strtoul(header.c_str() + cl + 16, 0, 10);
+		while (buf_.size() < end + 4 + len) {
+			if (!fill()) return false;
+		}
+		buf_.erase(0, end + 4 + len);
+		if (close || !opt_.keepAlive) disconnect();
+		return true;
+	}
+public:
+	Client(const Options& opt, const addrinfo *addr) : opt_(opt), addr_(addr), fd_(-1) { }
+	~Client() { disconnect(); }
+	/**
+		@return status code or -1 for error
+	*/
+	int get(const std::string& request)
+	{
+		for (int retry = 0; retry < 2; retry++) {
+			const bool reused = fd_ >= 0;
+			if (!reused && !connect()) return -1;
+			int status;
+			if (send(fd_, request.data(), request.size(), MSG_NOSIGNAL) == (ssize_t)request.size() && readResponse(status)) return status;
+			disconnect();
+			if (!reused) break;
+		}
+		return -1;
+	}
+};
+
+struct Result {
+	std::vector<double> latencies; //!< msec
+	int errors;
+	Result() : errors(0) { }
+};
+
+void run(Result *result, const Options *opt, const addrinfo *addr, const std::vector<std::string> *requests, size_t offset, Clock::time_point deadline)
+{
+	Client client(*opt, addr);
+	for (size_t i = offset; Clock::now() < deadline; i++) {
+		const std::string& req = (*requests)[i % requests->size()];
+		const Clock::time_point start = Clock::now();
+		const int status = client.get(req);
+		const double msec = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (status == 200) {
+			result->latencies.push_back(msec);
+		} else {
+			result->errors++;
+		}
+	}
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) return 0;
+	return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+int main(int argc, char *argv[])
+	try
+{
+	Options opt;
+	parseOptions(opt, argc, argv);
+
+	std::vector<std::string> requests;
+	std::string line;
+	for (size_t i = 0; i < opt.files.size(); i++) {
+		ldig::LineReader reader(opt.files[i]);
+		while (reader.getline(line)) {
+			if (line.empty()) continue;
+			requests.push_back(std::string(opt.explain ? "GET /detect?explain=1&text=" : "GET /detect?text=") + encodeURIComponent(line) + " HTTP/1.1\r\nHost: " + opt.host
+				+ (opt.keepAlive ? "\r\n\r\n" : "\r\nConnection: close\r\n\r\n"));
+		}
+	}
+	if (requests.empty()) throw cybozu::Exception("ldigload") << "no text";
+
+	addrinfo hints, *addr;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(opt.host.c_str(), opt.port.c_str(), &hints, &addr) != 0) {
+		throw cybozu::Exception("ldigload") << "unknown host" << opt.host;
+	}
+
+	std::vector<Result> results(opt.connections);
+	const Clock::time_point start = Clock::now();
+	const Clock::time_point deadline = start + std::chrono::microseconds((long long)(opt.duration * 1e6));
+	std::vector<std::thread> threads;
+	for (int i = 0; i < opt.connections; i++) {
+		threads.push_back(std::thread(run, &results[i], &opt, addr, &requests, requests.size() * i / opt.connections, deadline));
+	}
+	for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+	const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	freeaddrinfo(addr);
+
+	std::vector<double> latencies;
+	int errors = 0;
+	for (size_t i = 0; i < results.size(); i++) {
+		latencies.insert(latencies.end(), results[i].latencies.begin(), results[i].latencies.end());
+		errors += results[i].errors;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	printf("> connections = %d, keep-alive = %s, %.2f sec\n", opt.connections, opt.keepAlive ? "on" : "off", elapsed);
+	printf("> requests = %d, errors = %d, %.1f requests/sec\n", (int)latencies.size(), errors, latencies.size() / elapsed);
+	printf("> latency (msec) : p50 = %.3f, p90 = %.3f, p99 = %.3f, max = %.3f\n",
+		percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99), latencies.empty() ? 0 : latencies.back());
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "ERR:" << e.what() << std::endl;
+	return 1;
+}
@@ -0,0 +1,250 @@
+/**
+	@file
+	@brief renumber the features of a model by a profile (ldigdetect --profile)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include "model.hpp"
+#include "profile.hpp"
+
+struct Options {
+	std::string model;
+	std::string profile;
+	std::string output;
+};
+
+void usage()
+{
+	std::cerr << "usage: ldigrenum -m [model directory] -p [profile.npz] [-o output directory (default: the model)]" << std::endl;
+	exit(1);
+}
+
+void parseOptions(Options& opt, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const std::string a = argv[i];
+		if (i + 1 < argc && a == "-m") {
+			opt.model = argv[++i];
+		} else if (i + 1 < argc && a == "-p") {
+			opt.profile = argv[++i];
+		} else if (i + 1 < argc && a == "-o") {
+			opt.output = argv[++i];
+		} else {
+			usage();
+		}
+	}
+	if (opt.model.empty() || opt.profile.empty()) usage();
+	if (opt.output.empty()) opt.output = opt.model;
+}
+
+/*
+	order of the features:
+	the hit features first, then the others, both in the preorder of the trie
+	whose children are visited in descending order of the hits of their subtrees,
+	so the frequent features are packed into the first rows of the parameters
+	and a feature is next to its prefixes, which the same walk visits just before
+*/
+void makeOrder(std::vector<int>& order, const ldig::Model& model, const std::vector<uint64_t>& hits)
+{
+	const ldig::DoubleArray& trie = model.trie;
+	const int N = trie.size();
+	const size_t M = model.M;
+	/* children of each node (CSR), same as EarlyExit */
+	std::vector<int> begin(N + 1), children(N);
+	for (int i = 0; i < N; i++) {
+		const int p = trie.parent(i);
+		if (p >= 0) begin[p + 1]++;
+	}
+	for (int i = 0; i < N; i++) begin[i + 1] += begin[i];
+	std::vector<int> pos(begin.begin(), begin.end() - 1);
+	for (int i = 0; i < N; i++) {
+		const int p = trie.parent(i);
+		if (p >= 0) children[pos[p]++] = i;
+	}
+	/* hits of subtrees (children come after their parent in BFS order) */
+	std::vector<int> bfs;
+	bfs.reserve(N);
+	bfs.push_back(0);
+	for (size_t i = 0; i < bfs.size(); i++) {
+		const int v = bfs[i];
+		bfs.insert(bfs.end(), &children[0] + begin[v], &children[0] + begin[v + 1]);
+	}
+	std::vector<uint64_t> sub(N);
+	for (size_t i = bfs.size(); i > 0; i--) {
+		const int v = bfs[i - 1];
+		const int id = trie.value(v);
+		if (id >= 0 && (size_t)id < M) sub[v] += hits[id];
+		const int p = trie.parent(v);
+		if (p >= 0) sub[p] += sub[v];
+	}
+	std::vector<int> hot, cold;
+	std::vector<bool> visited(M);
+	std::vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		const int v = stack.back();
+		stack.pop_back();
+		const int id = trie.value(v);
+		if (id >= 0 && (size_t)id < M && !visited[id]) {
+			visited[id] = true;
+			(hits[id] > 0 ? hot : cold).push_back(id);
+		}
+		/* pushed in ascending order of hits, so the most hit child is popped first */
+		std::vector<std::pair<uint64_t, int> > c;
+		for (int i = begin[v]; i < begin[v + 1]; i++) c.push_back(std::make_pair(sub[children[i]], -children[i]));
+		std::sort(c.begin(), c.end());
+		for (size_t i = 0; i < c.size(); i++) stack.push_back(-c[i].second);
+	}
+	/* features not in the trie keep their order at the end */
+	for (size_t id = 0; id < M; id++) {
+		if (!visited[id]) cold.push_back((int)id);
+	}
+	order.swap(hot);
+	order.insert(order.end(), cold.begin(), cold.end());
+}
+
+/*
+	number of the blocks of the parameters (rows of K doubles) which have the given ratio of hits
+	@param rowOf [in] row of each feature
+*/
+size_t blocksOf(const std::vector<uint64_t>& hits, const std::vector<int>& rowOf, size_t K, size_t blockSize, double ratio)
+{
+	const size_t rowSize = K * sizeof(double);
+	std::map<size_t, uint64_t> blocks;
+	for (size_t id = 0; id < hits.size(); id++) {
+		if (hits[id] == 0) continue;
+		const size_t begin = rowOf[id] * rowSize / blockSize, end = ((rowOf[id] + 1) * rowSize - 1) / blockSize;
+		for (size_t b = begin; b <= end; b++) blocks[b] += hits[id];
+	}
+	std::vector<uint64_t> v;
+	uint64_t all = 0;
+	for (std::map<size_t, uint64_t>::const_iterator i = blocks.begin(); i != blocks.end(); ++i) {
+		v.push_back(i->second);
+		all += i->second;
+	}
+	std::sort(v.rbegin(), v.rend());
+	/* a row over 2 blocks counts its hits twice, so the ratio is of the sum of the blocks */
+	uint64_t sum = 0;
+	for (size_t i = 0; i < v.size(); i++) {
+		sum += v[i];
+		if (sum >= all * ratio) return i + 1;
+	}
+	return v.size();
+}
+
+void report(const std::vector<uint64_t>& hits, const std::vector<int>& before, const std::vector<int>& after, size_t K)
+{
+	static const struct {
+		const char *name;
+		size_t size;
+	} tbl[] = { { "cache lines", 64 }, { "pages", 4096 } };
+	static const double ratio[] = { 0.9, 0.99, 1.0 };
+	for (size_t i = 0; i < sizeof(tbl) / sizeof(tbl[0]); i++) {
+		for (size_t j = 0; j < sizeof(ratio) / sizeof(ratio[0]); j++) {
+			fprintf(stderr, "> %s for %3.0f%% of hits : %llu => %llu\n", tbl[i].name, ratio[j] * 100,
+				(unsigned long long)blocksOf(hits, before, K, tbl[i].size, ratio[j]),
+				(unsigned long long)blocksOf(hits, after, K, tbl[i].size, ratio[j]));
+		}
+	}
+}
+
+void writeFile(const std::string& path, const std::string& data)
+{
+	std::ofstream ofs(path.c_str(), std::ios::binary);
+	ofs.write(data.data(), data.size());
+	if (!ofs) throw cybozu::Exception("ldigrenum") << "can't write" << path;
+}
+
+int main(int argc, char *argv[])
+	try
+{
+	Options opt;
+	parseOptions(opt, argc, argv);
+
+	ldig::Model model;
+	model.load(opt.model);
+	ldig::Profile profile;
+	profile.load(opt.profile);
+	if (profile.trieHash != model.trieHash) throw cybozu::Exception("ldigrenum") << "profile is not of the model" << opt.profile;
+	if (profile.hits.size() != model.M) throw cybozu::Exception("ldigrenum") << "profile doesn't match parameters" << profile.hits.size() << model.M;
+	if (profile.texts() == 0) throw cybozu::Exception("ldigrenum") << "profile has no texts" << opt.profile;
+	const size_t M = model.M, K = model.K;
+
+	std::string buf;
+	ldig::readFile(buf, model.featuresPath());
+	std::vector<std::string> lines;
+	lines.reserve(M);
+	for (size_t p = 0; p < buf.size();) {
+		size_t q = buf.find('\n', p);
+		if (q == std::string::npos) q = buf.size();
+		lines.push_back(buf.substr(p, q - p));
+		p = q + 1;
+	}
+	if (lines.size() != M) throw cybozu::Exception("ldigrenum") << "features doesn't match parameters" << lines.size() << M;
+
+	std::vector<int> order;
+	makeOrder(order, model, profile.hits);
+	std::vector<int> before(M), after(M); // row of each (old) id
+	for (size_t i = 0; i < M; i++) {
+		before[i] = (int)i;
+		after[order[i]] = (int)i;
+	}
+	const size_t hot = M - std::count(profile.hits.begin(), profile.hits.end(), 0);
+	fprintf(stderr, "> hit features : %llu / %llu\n", (unsigned long long)hot, (unsigned long long)M);
+	report(profile.hits, before, after, K);
+
+	/* trie : only the values (ids) are changed */
+	std::map<std::string, ldig::npy::Array> arrays;
+	ldig::npy::loadNpz(arrays, model.doublearrayPath());
+	std::vector<int32_t> value;
+	arrays["value"].get(value);
+	for (size_t i = 0; i < value.size(); i++) {
+		if (value[i] >= 0 && (size_t)value[i] < M) value[i] = after[value[i]];
+	}
+	ldig::npy::Array& a = arrays["value"];
+	a.descr = "<i4";
+	a.data.assign((const char *)&value[0], value.size() * sizeof(int32_t));
+
+	std::vector<double> param(M * K);
+	std::string features;
+	for (size_t i = 0; i < M; i++) {
+		std::copy(&model.param[order[i] * K], &model.param[order[i] * K] + K, &param[i * K]);
+		features += lines[order[i]];
+		features += '\n';
+	}
+
+	/*
+		the files are written as .tmp and renamed after all of them are written,
+		so a failure doesn't leave the trie, the parameters and the features mismatched
+	*/
+	std::vector<std::string> files;
+	if (opt.output != opt.model) {
+		std::string json;
+		ldig::readFile(json, model.labelsPath());
+		files.push_back("labels.json");
+		writeFile(opt.output + "/labels.json.tmp", json);
+	}
+	files.push_back("doublearray.npz");
+	ldig::npy::saveNpz(opt.output + "/doublearray.npz.tmp", arrays);
+	files.push_back("parameters.npy");
+	ldig::npy::saveMatrix(opt.output + "/parameters.npy.tmp", &param[0], M, K);
+	files.push_back("features");
+	writeFile(opt.output + "/features.tmp", features);
+	for (size_t i = 0; i < files.size(); i++) {
+		const std::string path = opt.output + "/" + files[i];
+		if (rename((path + ".tmp").c_str(), path.c_str()) != 0) throw cybozu::Exception("ldigrenum") << "can't rename" << path;
+	}
+	fprintf(stderr, "> renumbered => %s\n", opt.output.c_str());
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "ERR:" << e.what() << std::endl;
+	return 1;
+}
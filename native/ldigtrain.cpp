@@ -0,0 +1,383 @@
+/**
+	@file
+	@brief online trainer of ldig model (native version of ldig.py --learning)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "model.hpp"
+#include "corpus.hpp"
+
+struct Options {
+	std::string model;
+	double eta;
+	double regConst;
+	unsigned int seed;
+	int threads;
+	bool useCache;
+	std::vector<std::string> files;
+	Options() : eta(0.1), regConst(0), seed((unsigned int)time(0)), threads(1), useCache(true) { }
+};
+
+void usage()
+{
+	std::cerr << "usage: ldigtrain -m [model directory] [-e eta] [-r regularization constant] [-s seed] [-t threads] [--no-cache] [corpus files]" << std::endl;
+	exit(1);
+}
+
+void parseOptions(Options& opt, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const std::string a = argv[i];
+		if (i + 1 < argc && a == "-m") {
+			opt.model = argv[++i];
+		} else if (i + 1 < argc && (a == "-e" || a == "--eta")) {
+			opt.eta = atof(argv[++i]);
+		} else if (i + 1 < argc && (a == "-r" || a == "--regularity")) {
+			opt.regConst = atof(argv[++i]);
+		} else if (i + 1 < argc && a == "-s") {
+			opt.seed = (unsigned int)atoi(argv[++i]);
+		} else if (i + 1 < argc && a == "-t") {
+			opt.threads = std::max(1, atoi(argv[++i]));
+		} else if (a == "--no-cache") {
+			opt.useCache = false;
+		} else if (a[0] == '-' && a != "-") {
+			usage();
+		} else {
+			opt.files.push_back(a);
+		}
+	}
+	if (opt.model.empty() || opt.files.empty()) usage();
+}
+
+void printTime(const char *msg)
+{
+	char buf[16];
+	time_t t = time(0);
+	strftime(buf, sizeof(buf), "%H:%M:%S", localtime(&t));
+	printf("%s... %s\n", msg, buf);
+	fflush(stdout);
+}
+
+inline uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/*
+	pseudo random permutation of [0, n) without a table
+	(Feistel network on the next power of 4, walking cycles until the value falls in range)
+*/
+class Permutation {
+	uint64_t n_;
+	uint64_t key_;
+	int half_;
+	uint64_t mask_;
+public:
+	Permutation(uint64_t n, uint64_t key)
+		: n_(n), key_(key), half_(1)
+	{
+		while ((uint64_t(1) << (half_ * 2)) < n) half_++;
+		mask_ = (uint64_t(1) << half_) - 1;
+	}
+	uint64_t operator()(uint64_t x) const
+	{
+		do {
+			uint64_t l = x >> half_, r = x & mask_;
+			for (int i = 0; i < 4; i++) {
+				const uint64_t t = l ^ (mix64(r ^ key_ ^ (uint64_t)i << 56) & mask_);
+				l = r;
+				r = t;
+			}
+			x = (l << half_) | r;
+		} while (x >= n_);
+		return x;
+	}
+};
+
+/*
+	class-balanced visiting order, generated on the fly.
+	as ldig.shuffle, every label is visited as many times as the largest label;
+	the r-th round over the texts of a label follows its own permutation,
+	and labels are interleaved at random weighted by their remaining visits.
+	a sampler generates a shard [shard / shards, (shard + 1) / shards) of the visits of each label.
+*/
+class BalancedSampler {
+	const std::vector<std::vector<int> >& idlist_;
+	uint64_t seed_;
+	std::vector<size_t> cur_;
+	std::vector<size_t> end_;
+	size_t remaining_;
+	std::mt19937_64 rng_;
+	size_t label_;
+	size_t round_;
+	Permutation perm_;
+public:
+	BalancedSampler(const std::vector<std::vector<int> >& idlist, size_t visits, uint64_t seed, int shard, int shards)
+		: idlist_(idlist), seed_(seed), cur_(idlist.size()), end_(idlist.size()), remaining_(0)
+		, rng_(mix64(seed + shard)), label_(size_t(-1)), round_(0), perm_(1, 0)
+	{
+		for (size_t k = 0; k < idlist.size(); k++) {
+			if (idlist[k].empty()) continue;
+			cur_[k] = visits * shard / shards;
+			end_[k] = visits * (shard + 1) / shards;
+			remaining_ += end_[k] - cur_[k];
+		}
+	}
+	/**
+		get index of the next text
+		@return false if all visits are done
+	*/
+	bool next(int& text)
+	{
+		if (remaining_ == 0) return false;
+		size_t r = std::uniform_int_distribution<size_t>(0, remaining_ - 1)(rng_);
+		size_t k = 0;
+		while (r >= end_[k] - cur_[k]) {
+			r -= end_[k] - cur_[k];
+			k++;
+		}
+		const std::vector<int>& ids = idlist_[k];
+		const size_t v = cur_[k]++;
+		remaining_--;
+		if (k != label_ || v / ids.size() != round_) {
+			label_ = k;
+			round_ = v / ids.size();
+			perm_ = Permutation(ids.size(), mix64(seed_ ^ mix64(k * 0x10000 + round_)));
+		}
+		text = ids[perm_(v % ids.size())];
+		return true;
+	}
+};
+
+/*
+	learning rate and cumulative penalty of the m-th update.
+	they are functions of m so that workers can share them by a step counter.
+*/
+class Schedule {
+	double eta0_;
+	double regConst_;
+	size_t N_;
+	double logAlpha_; //!< alpha = 0.9 ** (-1 / N)
+public:
+	Schedule(double eta0, double regConst, size_t N)
+		: eta0_(eta0), regConst_(regConst), N_(N), logAlpha_(-log(0.9) / N)
+	{
+	}
+	bool regularize() const { return regConst_ != 0; }
+	double eta(size_t m) const
+	{
+		return regularize() ? eta0_ * exp((m + 1) * logAlpha_) : eta0_;
+	}
+	/* sum of regConst * eta(i) / N for i <= m */
+	double uk(size_t m) const
+	{
+		if (!regularize()) return 0;
+		return regConst_ / N_ * eta0_ * exp(logAlpha_) * expm1((m + 1) * logAlpha_) / expm1(logAlpha_);
+	}
+};
+
+/*
+	L1 regularization with cumulative penalty (Tsuruoka et al. 2009).
+	penalty of each feature is applied lazily when the feature appears,
+	and stamp records the step where it was applied last,
+	so that only stale features are regularized at the end.
+*/
+class CumulativePenalty {
+	std::vector<double> penalties_;
+	std::vector<int> stamp_;
+	const size_t K_;
+public:
+	CumulativePenalty(size_t M, size_t K)
+		: penalties_(M * K), stamp_(M, -1), K_(K)
+	{
+	}
+	void apply(double *prm, int id, double uk, int step)
+	{
+		if (stamp_[id] == step) return;
+		stamp_[id] = step;
+		double *pnl = &penalties_[id * K_];
+		for (size_t j = 0; j < K_; j++) {
+			const double w = prm[j];
+			if (w > 0) {
+				const double w1 = w - uk - pnl[j];
+				if (w1 > 0) {
+					prm[j] = w1;
+					pnl[j] += w1 - w;
+				} else {
+					prm[j] = 0;
+					pnl[j] -= w;
+				}
+			} else if (w < 0) {
+				const double w1 = w + uk - pnl[j];
+				if (w1 < 0) {
+					prm[j] = w1;
+					pnl[j] += w1 - w;
+				} else {
+					prm[j] = 0;
+					pnl[j] -= w;
+				}
+			}
+		}
+	}
+	void applyAll(double *param, size_t M, double uk, int step)
+	{
+		for (size_t id = 0; id < M; id++) apply(param + id * K_, (int)id, uk, step);
+	}
+};
+
+/*
+	SGD over a shard of the balanced visits.
+	workers update the shared parameters without locks (Hogwild!, Niu et al. 2011);
+	updates of one text touch only its features, so collisions are rare and benign.
+*/
+class Worker {
+	const ldig::Model& model_;
+	const ldig::FeaturizedCorpus& corpus_;
+	const Schedule& schedule_;
+	double *param_;
+	CumulativePenalty& penalty_;
+	std::atomic<size_t>& step_;
+public:
+	std::vector<int> corrects;
+	std::vector<int> counts;
+
+	Worker(ldig::Model& model, const ldig::FeaturizedCorpus& corpus, const Schedule& schedule, CumulativePenalty& penalty, std::atomic<size_t>& step)
+		: model_(model), corpus_(corpus), schedule_(schedule), param_(&model.param[0])
+		, penalty_(penalty), step_(step), corrects(model.K), counts(model.K)
+	{
+	}
+	void run(BalancedSampler *sampler)
+	{
+		const size_t K = model_.K;
+		std::vector<double> y(K);
+		int target;
+		while (sampler->next(target)) {
+			const int label = corpus_.label(target);
+			const ldig::Event *events = corpus_.events(target);
+			const size_t n = corpus_.length(target);
+			model_.predict(&y[0], events, n);
+			const int predict = (int)(std::max_element(y.begin(), y.end()) - y.begin());
+			counts[label]++;
+			if (label == predict) corrects[label]++;
+
+			// learning
+			const size_t m = step_.fetch_add(1, std::memory_order_relaxed);
+			const double eta = schedule_.eta(m);
+			const double uk = schedule_.uk(m);
+			y[label] -= 1;
+			for (size_t k = 0; k < K; k++) y[k] *= eta;
+			for (size_t i = 0; i < n; i++) {
+				double *prm = param_ + events[i].id * K;
+				const double freq = events[i].count;
+				for (size_t k = 0; k < K; k++) prm[k] -= y[k] * freq;
+				if (schedule_.regularize()) penalty_.apply(prm, events[i].id, uk, (int)m);
+			}
+		}
+	}
+};
+
+/*
+	inference and learning (same as ldig.inference)
+*/
+void inference(ldig::Model& model, const ldig::FeaturizedCorpus& corpus, const Options& opt)
+{
+	const size_t K = model.K, M = model.M;
+	std::vector<std::vector<int> > idlist(K);
+	for (size_t i = 0; i < corpus.size(); i++) idlist[corpus.label(i)].push_back((int)i);
+	size_t visits = 0, nLabels = 0;
+	for (size_t k = 0; k < K; k++) {
+		visits = std::max(visits, idlist[k].size());
+		if (!idlist[k].empty()) nLabels++;
+	}
+	const size_t N = visits * nLabels;
+
+	const Schedule schedule(opt.eta, opt.regConst, N);
+	CumulativePenalty penalty(schedule.regularize() ? M : 0, K);
+	std::atomic<size_t> step(0);
+	std::vector<Worker> workers(opt.threads, Worker(model, corpus, schedule, penalty, step));
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<BalancedSampler> samplers;
+	for (int t = 0; t < opt.threads; t++) samplers.push_back(BalancedSampler(idlist, visits, opt.seed, t, opt.threads));
+	if (opt.threads == 1) {
+		workers[0].run(&samplers[0]);
+	} else {
+		std::vector<std::thread> threads;
+		for (int t = 0; t < opt.threads; t++) {
+			threads.push_back(std::thread(&Worker::run, &workers[t], &samplers[t]));
+		}
+		for (int t = 0; t < opt.threads; t++) threads[t].join();
+	}
+	double *param = &model.param[0];
+	if (schedule.regularize()) penalty.applyAll(param, M, schedule.uk(N - 1), (int)N);
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int totalCorrects = 0;
+	for (size_t k = 0; k < K; k++) {
+		int crct = 0, cnt = 0;
+		for (int t = 0; t < opt.threads; t++) {
+			crct += workers[t].corrects[k];
+			cnt += workers[t].counts[k];
+		}
+		totalCorrects += crct;
+		if (cnt > 0) {
+			printf(">    %s = %d / %d = %.2f\n", model.labels[k].c_str(), crct, cnt, 100.0 * crct / cnt);
+		}
+	}
+	printf("> total = %d / %d = %.2f\n", totalCorrects, (int)N, 100.0 * totalCorrects / N);
+	int relevant = 0;
+	for (size_t id = 0; id < M; id++) {
+		double sum = 0;
+		for (size_t k = 0; k < K; k++) sum += std::fabs(param[id * K + k]);
+		if (sum > 0.0000001) relevant++;
+	}
+	printf("> # of relevant features = %d / %d\n", relevant, (int)M);
+	printf("> threads = %d, %.2f sec, %.0f texts/sec\n", opt.threads, elapsed, N / elapsed);
+}
+
+int main(int argc, char *argv[])
+	try
+{
+	Options opt;
+	parseOptions(opt, argc, argv);
+
+	ldig::Model model;
+	model.load(opt.model);
+
+	printTime("loading corpus");
+	ldig::FeaturizedCorpus corpus;
+	for (size_t i = 0; i < opt.files.size(); i++) corpus.add(opt.files[i], model, opt.useCache, opt.threads);
+	for (size_t i = 0; i < corpus.size(); i++) {
+		if (corpus.label(i) < 0) {
+			std::string file;
+			size_t line;
+			corpus.getLocation(file, line, i);
+			cybozu::Exception e("ldigtrain");
+			e << "unknown label" << file << line;
+			throw e;
+		}
+	}
+	printTime("inference");
+	inference(model, corpus, opt);
+	printTime("finish");
+	model.saveParam();
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "ERR:" << e.what() << std::endl;
+	return 1;
+}
@@ -0,0 +1,169 @@
+#pragma once
+/**
+	@file
+	@brief counters and latency histograms in the text format of Prometheus
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdint.h>
+
+namespace ldig {
+
+/**
+	stages of detection
+*/
+enum Stage {
+	stageNormalize,
+	stageExtract,
+	stageScore,
+	stageSerialize,
+	stageN
+};
+
+inline const char *stageName(int stage)
+{
+	static const char *tbl[] = { "normalize", "extract", "score", "serialize" };
+	return tbl[stage];
+}
+
+inline uint64_t nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+	counter written by one thread and read by the others
+	(relaxed load and store, so no locked instruction)
+*/
+class Counter {
+	std::atomic<uint64_t> v_;
+public:
+	Counter() : v_(0) { }
+	void add(uint64_t x) { v_.store(v_.load(std::memory_order_relaxed) + x, std::memory_order_relaxed); }
+	void set(uint64_t x) { v_.store(x, std::memory_order_relaxed); }
+	uint64_t get() const { return v_.load(std::memory_order_relaxed); }
+};
+
+/**
+	latency histogram of a thread
+*/
+class Histogram {
+public:
+	static const size_t bucketN = 19;
+	static const uint64_t *bounds() //!< upper bounds of buckets (ns)
+	{
+		static const uint64_t tbl[bucketN] = {
+			1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+			1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000, 1000000000
+		};
+		return tbl;
+	}
+	Counter buckets[bucketN + 1]; //!< the last is +Inf
+	Counter sum; //!< ns
+	void add(uint64_t ns)
+	{
+		const uint64_t *b = bounds();
+		size_t i = 0;
+		while (i < bucketN && ns > b[i]) i++;
+		buckets[i].add(1);
+		sum.add(ns);
+	}
+};
+
+/**
+	time of the stages of a request (or a line of batch)
+*/
+struct StageTimes {
+	uint64_t ns[stageN];
+	unsigned int done; //!< bit of the stages measured
+	uint64_t last;
+	StageTimes() : done(0), last(0) { }
+	void start()
+	{
+		done = 0;
+		last = nowNs();
+	}
+	void lap(Stage stage)
+	{
+		const uint64_t t = nowNs();
+		ns[stage] = t - last;
+		done |= 1u << stage;
+		last = t;
+	}
+};
+
+namespace metrics_local {
+
+inline void appendValue(std::string& out, const char *name, const std::string& labels, double v)
+{
+	char buf[64];
+	out += name;
+	if (!labels.empty()) {
+		out += '{';
+		out += labels;
+		out += '}';
+	}
+	if (v >= 0 && v < 9007199254740992.0 && v == (double)(uint64_t)v) {
+		snprintf(buf, sizeof(buf), " %llu\n", (unsigned long long)v);
+	} else {
+		snprintf(buf, sizeof(buf), " %.10g\n", v);
+	}
+	out += buf;
+}
+
+} // metrics_local
+
+/**
+	writer of the text format (version 0.0.4)
+*/
+struct MetricsWriter {
+	std::string& out;
+	explicit MetricsWriter(std::string& out) : out(out) { }
+	void header(const char *name, const char *type, const char *help)
+	{
+		out += "# HELP ";
+		out += name;
+		out += ' ';
+		out += help;
+		out += "\n# TYPE ";
+		out += name;
+		out += ' ';
+		out += type;
+		out += '\n';
+	}
+	void value(const char *name, const std::string& labels, double v)
+	{
+		metrics_local::appendValue(out, name, labels, v);
+	}
+	/**
+		sum of the histograms of the threads (in seconds)
+	*/
+	void histogram(const char *name, const std::string& labels, const std::vector<const Histogram*>& hs)
+	{
+		const uint64_t *bounds = Histogram::bounds();
+		const std::string sep = labels.empty() ? "" : ",";
+		const std::string bucket = std::string(name) + "_bucket";
+		uint64_t count = 0;
+		double sum = 0;
+		char le[64];
+		for (size_t i = 0; i <= Histogram::bucketN; i++) {
+			for (size_t j = 0; j < hs.size(); j++) count += hs[j]->buckets[i].get();
+			if (i < Histogram::bucketN) {
+				snprintf(le, sizeof(le), "le=\"%g\"", bounds[i] * 1e-9);
+			} else {
+				snprintf(le, sizeof(le), "le=\"+Inf\"");
+			}
+			metrics_local::appendValue(out, bucket.c_str(), labels + sep + le, (double)count);
+		}
+		for (size_t j = 0; j < hs.size(); j++) sum += hs[j]->sum.get() * 1e-9;
+		metrics_local::appendValue(out, (std::string(name) + "_sum").c_str(), labels, sum);
+		metrics_local::appendValue(out, (std::string(name) + "_count").c_str(), labels, (double)count);
+	}
+};
+
+} // ldig
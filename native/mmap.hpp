@@ -0,0 +1,83 @@
+#pragma once
+/**
+	@file
+	@brief read-only memory mapped file
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include "cybozu/exception.hpp"
+#ifdef _WIN32
+	#include <fstream>
+	#include <vector>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace ldig {
+
+class MappedFile {
+	const char *p_;
+	size_t size_;
+#ifdef _WIN32
+	std::vector<char> buf_;
+#endif
+	MappedFile(const MappedFile&);
+	void operator=(const MappedFile&);
+public:
+	MappedFile() : p_(0), size_(0) { }
+	~MappedFile() { close(); }
+	/**
+		map file
+		@return false if the file can't be opened
+	*/
+	bool open(const std::string& path)
+	{
+		close();
+#ifdef _WIN32
+		std::ifstream ifs(path.c_str(), std::ios::binary);
+		if (!ifs) return false;
+		buf_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		p_ = buf_.empty() ? 0 : &buf_[0];
+		size_ = buf_.size();
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			::close(fd);
+			return false;
+		}
+		size_ = st.st_size;
+		if (size_ > 0) {
+			void *p = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED) {
+				::close(fd);
+				cybozu::Exception e("mmap");
+				e << path << cybozu::ErrorNo().toString();
+				throw e;
+			}
+			p_ = (const char *)p;
+		}
+		::close(fd);
+#endif
+		return true;
+	}
+	void close()
+	{
+#ifdef _WIN32
+		buf_.clear();
+#else
+		if (p_) munmap((void *)p_, size_);
+#endif
+		p_ = 0;
+		size_ = 0;
+	}
+	const char *data() const { return p_; }
+	size_t size() const { return size_; }
+};
+
+} // ldig
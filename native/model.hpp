@@ -0,0 +1,161 @@
+#pragma once
+/**
+	@file
+	@brief ldig model directory (labels.json, parameters.npy, doublearray.npz)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include <vector>
+#include <cmath>
+#include "doublearray.hpp"
+#include "cybozu/string.hpp"
+
+namespace ldig {
+
+namespace model_local {
+
+/* parse JSON array of strings (labels.json) */
+inline void parseStringArray(std::vector<std::string>& out, const std::string& json)
+{
+	out.clear();
+	size_t i = json.find('[');
+	if (i == std::string::npos) throw cybozu::Exception("model") << "bad labels";
+	for (i++; i < json.size(); i++) {
+		const char c = json[i];
+		if (c == ']') return;
+		if (c != '"') continue;
+		std::string s;
+		for (i++; i < json.size() && json[i] != '"'; i++) {
+			if (json[i] == '\\' && i + 1 < json.size()) {
+				i++;
+				if (json[i] == 'u' && i + 4 < json.size()) {
+					cybozu::string::AppendUtf8(s, (cybozu::Char)strtol(json.substr(i + 1, 4).c_str(), 0, 16));
+					i += 4;
+					continue;
+				}
+			}
+			s += json[i];
+		}
+		out.push_back(s);
+	}
+	throw cybozu::Exception("model") << "bad labels";
+}
+
+/* FNV-1a */
+inline uint64_t fnv1a(const char *p, size_t n, uint64_t h = 14695981039346656037ULL)
+{
+	for (size_t i = 0; i < n; i++) {
+		h ^= (unsigned char)p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+} // model_local
+
+class Model {
+	std::string dir_;
+public:
+	std::vector<std::string> labels;
+	std::vector<double> param; //!< M x K, row-major
+	size_t M;
+	size_t K;
+	DoubleArray trie;
+	uint64_t trieHash; //!< hash of trie and labels
+
+	Model() : M(0), K(0), trieHash(0) { }
+
+	const std::string& dir() const { return dir_; }
+	std::string featuresPath() const { return dir_ + "/features"; }
+	std::string labelsPath() const { return dir_ + "/labels.json"; }
+	std::string paramPath() const { return dir_ + "/parameters.npy"; }
+	std::string doublearrayPath() const { return dir_ + "/doublearray.npz"; }
+
+	void load(const std::string& dir)
+	{
+		dir_ = dir;
+		std::string json;
+		readFile(json, labelsPath());
+		model_local::parseStringArray(labels, json);
+		npy::Array a;
+		npy::load(a, paramPath());
+		if (a.shape.size() != 2 || a.shape[1] != labels.size()) {
+			cybozu::Exception e("model");
+			e << "parameters doesn't match labels" << paramPath();
+			throw e;
+		}
+		a.get(param);
+		M = a.shape[0];
+		K = a.shape[1];
+		trie.load(doublearrayPath());
+		std::string da;
+		readFile(da, doublearrayPath());
+		trieHash = model_local::fnv1a(json.data(), json.size(), model_local::fnv1a(da.data(), da.size()));
+	}
+	void saveParam() const
+	{
+		npy::saveMatrix(paramPath(), &param[0], M, K);
+	}
+	/**
+		@return index of label or -1
+	*/
+	int labelIndex(const std::string& label) const
+	{
+		for (size_t k = 0; k < K; k++) {
+			if (labels[k] == label) return (int)k;
+		}
+		return -1;
+	}
+	/**
+		extract features of normalized text with the boundary marks (u0001)
+	*/
+	void extract(Events& events, std::vector<int>& work, cybozu::String& buf, const cybozu::String& text) const
+	{
+		DoubleArray::NoWalk walk;
+		extract(events, work, buf, text, walk);
+	}
+	/**
+		@param walk [in] walk(transitions) for the walk of trie from each character
+	*/
+	template<class W>
+	void extract(Events& events, std::vector<int>& work, cybozu::String& buf, const cybozu::String& text, W& walk) const
+	{
+		buf.clear();
+		buf.push_back(1);
+		buf += text;
+		buf.push_back(1);
+		trie.extractFeatures(events, work, buf.data(), buf.size(), walk);
+	}
+	/**
+		prediction probability (same as ldig.predict)
+		@param y [out] K probabilities
+	*/
+	void predict(double *y, const Event *events, size_t n) const
+	{
+		for (size_t k = 0; k < K; k++) y[k] = 0;
+		for (size_t i = 0; i < n; i++) {
+			const double *w = &param[events[i].id * K];
+			const double freq = events[i].count;
+			for (size_t k = 0; k < K; k++) y[k] += w[k] * freq;
+		}
+		softmax(y, K);
+	}
+	void predict(double *y, const Events& events) const
+	{
+		predict(y, events.empty() ? 0 : &events[0], events.size());
+	}
+	static void softmax(double *y, size_t K)
+	{
+		double max = y[0];
+		for (size_t k = 1; k < K; k++) if (max < y[k]) max = y[k];
+		double sum = 0;
+		for (size_t k = 0; k < K; k++) {
+			y[k] = std::exp(y[k] - max);
+			sum += y[k];
+		}
+		for (size_t k = 0; k < K; k++) y[k] /= sum;
+	}
+};
+
+} // ldig
@@ -0,0 +1,629 @@
+#pragma once
+/**
+	@file
+	@brief text normalization (port of ldig.normalize_text)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include "cybozu/string.hpp"
+
+namespace ldig {
+
+namespace normalize_local {
+
+using cybozu::Char;
+using cybozu::String;
+
+struct Entity {
+	const char *name;
+	int code;
+};
+
+/* htmlentitydefs.name2codepoint (sorted by name) */
+static const Entity entityTbl[] = {
+	{ "AElig", 0x00c6 }, { "Aacute", 0x00c1 }, { "Acirc", 0x00c2 }, { "Agrave", 0x00c0 },
+	{ "Alpha", 0x0391 }, { "Aring", 0x00c5 }, { "Atilde", 0x00c3 }, { "Auml", 0x00c4 },
+	{ "Beta", 0x0392 }, { "Ccedil", 0x00c7 }, { "Chi", 0x03a7 }, { "Dagger", 0x2021 },
+	{ "Delta", 0x0394 }, { "ETH", 0x00d0 }, { "Eacute", 0x00c9 }, { "Ecirc", 0x00ca },
+	{ "Egrave", 0x00c8 }, { "Epsilon", 0x0395 }, { "Eta", 0x0397 }, { "Euml", 0x00cb },
+	{ "Gamma", 0x0393 }, { "Iacute", 0x00cd }, { "Icirc", 0x00ce }, { "Igrave", 0x00cc },
+	{ "Iota", 0x0399 }, { "Iuml", 0x00cf }, { "Kappa", 0x039a }, { "Lambda", 0x039b },
+	{ "Mu", 0x039c }, { "Ntilde", 0x00d1 }, { "Nu", 0x039d }, { "OElig", 0x0152 },
+	{ "Oacute", 0x00d3 }, { "Ocirc", 0x00d4 }, { "Ograve", 0x00d2 }, { "Omega", 0x03a9 },
+	{ "Omicron", 0x039f }, { "Oslash", 0x00d8 }, { "Otilde", 0x00d5 }, { "Ouml", 0x00d6 },
+	{ "Phi", 0x03a6 }, { "Pi", 0x03a0 }, { "Prime", 0x2033 }, { "Psi", 0x03a8 }, { "Rho", 0x03a1 },
+	{ "Scaron", 0x0160 }, { "Sigma", 0x03a3 }, { "THORN", 0x00de }, { "Tau", 0x03a4 },
+	{ "Theta", 0x0398 }, { "Uacute", 0x00da }, { "Ucirc", 0x00db }, { "Ugrave", 0x00d9 },
+	{ "Upsilon", 0x03a5 }, { "Uuml", 0x00dc }, { "Xi", 0x039e }, { "Yacute", 0x00dd },
+	{ "Yuml", 0x0178 }, { "Zeta", 0x0396 }, { "aacute", 0x00e1 }, { "acirc", 0x00e2 },
+	{ "acute", 0x00b4 }, { "aelig", 0x00e6 }, { "agrave", 0x00e0 }, { "alefsym", 0x2135 },
+	{ "alpha", 0x03b1 }, { "amp", 0x0026 }, { "and", 0x2227 }, { "ang", 0x2220 }, { "aring", 0x00e5 },
+	{ "asymp", 0x2248 }, { "atilde", 0x00e3 }, { "auml", 0x00e4 }, { "bdquo", 0x201e },
+	{ "beta", 0x03b2 }, { "brvbar", 0x00a6 }, { "bull", 0x2022 }, { "cap", 0x2229 },
+	{ "ccedil", 0x00e7 }, { "cedil", 0x00b8 }, { "cent", 0x00a2 }, { "chi", 0x03c7 },
+	{ "circ", 0x02c6 }, { "clubs", 0x2663 }, { "cong", 0x2245 }, { "copy", 0x00a9 },
+	{ "crarr", 0x21b5 }, { "cup", 0x222a }, { "curren", 0x00a4 }, { "dArr", 0x21d3 },
+	{ "dagger", 0x2020 }, { "darr", 0x2193 }, { "deg", 0x00b0 }, { "delta", 0x03b4 },
+	{ "diams", 0x2666 }, { "divide", 0x00f7 }, { "eacute", 0x00e9 }, { "ecirc", 0x00ea },
+	{ "egrave", 0x00e8 }, { "empty", 0x2205 }, { "emsp", 0x2003 }, { "ensp", 0x2002 },
+	{ "epsilon", 0x03b5 }, { "equiv", 0x2261 }, { "eta", 0x03b7 }, { "eth", 0x00f0 },
+	{ "euml", 0x00eb }, { "euro", 0x20ac }, { "exist", 0x2203 }, { "fnof", 0x0192 },
+	{ "forall", 0x2200 }, { "frac12", 0x00bd }, { "frac14", 0x00bc }, { "frac34", 0x00be },
+	{ "frasl", 0x2044 }, { "gamma", 0x03b3 }, { "ge", 0x2265 }, { "gt", 0x003e }, { "hArr", 0x21d4 },
+	{ "harr", 0x2194 }, { "hearts", 0x2665 }, { "hellip", 0x2026 }, { "iacute", 0x00ed },
+	{ "icirc", 0x00ee }, { "iexcl", 0x00a1 }, { "igrave", 0x00ec }, { "image", 0x2111 },
+	{ "infin", 0x221e }, { "int", 0x222b }, { "iota", 0x03b9 }, { "iquest", 0x00bf },
+	{ "isin", 0x2208 }, { "iuml", 0x00ef }, { "kappa", 0x03ba }, { "lArr", 0x21d0 },
+	{ "lambda", 0x03bb }, { "lang", 0x2329 }, { "laquo", 0x00ab }, { "larr", 0x2190 },
+	{ "lceil", 0x2308 }, { "ldquo", 0x201c }, { "le", 0x2264 }, { "lfloor", 0x230a },
+	{ "lowast", 0x2217 }, { "loz", 0x25ca }, { "lrm", 0x200e }, { "lsaquo", 0x2039 },
+	{ "lsquo", 0x2018 }, { "lt", 0x003c }, { "macr", 0x00af }, { "mdash", 0x2014 },
+	{ "micro", 0x00b5 }, { "middot", 0x00b7 }, { "minus", 0x2212 }, { "mu", 0x03bc },
+	{ "nabla", 0x2207 }, { "nbsp", 0x00a0 }, { "ndash", 0x2013 }, { "ne", 0x2260 }, { "ni", 0x220b },
+	{ "not", 0x00ac }, { "notin", 0x2209 }, { "nsub", 0x2284 }, { "ntilde", 0x00f1 },
+	{ "nu", 0x03bd }, { "oacute", 0x00f3 }, { "ocirc", 0x00f4 }, { "oelig", 0x0153 },
+	{ "ograve", 0x00f2 }, { "oline", 0x203e }, { "omega", 0x03c9 }, { "omicron", 0x03bf },
+	{ "oplus", 0x2295 }, { "or", 0x2228 }, { "ordf", 0x00aa }, { "ordm", 0x00ba },
+	{ "oslash", 0x00f8 }, { "otilde", 0x00f5 }, { "otimes", 0x2297 }, { "ouml", 0x00f6 },
+	{ "para", 0x00b6 }, { "part", 0x2202 }, { "permil", 0x2030 }, { "perp", 0x22a5 },
+	{ "phi", 0x03c6 }, { "pi", 0x03c0 }, { "piv", 0x03d6 }, { "plusmn", 0x00b1 }, { "pound", 0x00a3 },
+	{ "prime", 0x2032 }, { "prod", 0x220f }, { "prop", 0x221d }, { "psi", 0x03c8 },
+	{ "quot", 0x0022 }, { "rArr", 0x21d2 }, { "radic", 0x221a }, { "rang", 0x232a },
+	{ "raquo", 0x00bb }, { "rarr", 0x2192 }, { "rceil", 0x2309 }, { "rdquo", 0x201d },
+	{ "real", 0x211c }, { "reg", 0x00ae }, { "rfloor", 0x230b }, { "rho", 0x03c1 }, { "rlm", 0x200f },
+	{ "rsaquo", 0x203a }, { "rsquo", 0x2019 }, { "sbquo", 0x201a }, { "scaron", 0x0161 },
+	{ "sdot", 0x22c5 }, { "sect", 0x00a7 }, { "shy", 0x00ad }, { "sigma", 0x03c3 },
+	{ "sigmaf", 0x03c2 }, { "sim", 0x223c }, { "spades", 0x2660 }, { "sub", 0x2282 },
+	{ "sube", 0x2286 }, { "sum", 0x2211 }, { "sup", 0x2283 }, { "sup1", 0x00b9 }, { "sup2", 0x00b2 },
+	{ "sup3", 0x00b3 }, { "supe", 0x2287 }, { "szlig", 0x00df }, { "tau", 0x03c4 },
+	{ "there4", 0x2234 }, { "theta", 0x03b8 }, { "thetasym", 0x03d1 }, { "thinsp", 0x2009 },
+	{ "thorn", 0x00fe }, { "tilde", 0x02dc }, { "times", 0x00d7 }, { "trade", 0x2122 },
+	{ "uArr", 0x21d1 }, { "uacute", 0x00fa }, { "uarr", 0x2191 }, { "ucirc", 0x00fb },
+	{ "ugrave", 0x00f9 }, { "uml", 0x00a8 }, { "upsih", 0x03d2 }, { "upsilon", 0x03c5 },
+	{ "uuml", 0x00fc }, { "weierp", 0x2118 }, { "xi", 0x03be }, { "yacute", 0x00fd },
+	{ "yen", 0x00a5 }, { "yuml", 0x00ff }, { "zeta", 0x03b6 }, { "zwj", 0x200d }, { "zwnj", 0x200c },
+};
+
+/* unicode.lower() for the characters normalize_text leaves ('I' is excluded) */
+static const unsigned short lowerTbl[][2] = {
+	{ 0x0041, 0x0061 }, { 0x0042, 0x0062 }, { 0x0043, 0x0063 }, { 0x0044, 0x0064 },
+	{ 0x0045, 0x0065 }, { 0x0046, 0x0066 }, { 0x0047, 0x0067 }, { 0x0048, 0x0068 },
+	{ 0x004a, 0x006a }, { 0x004b, 0x006b }, { 0x004c, 0x006c }, { 0x004d, 0x006d },
+	{ 0x004e, 0x006e }, { 0x004f, 0x006f }, { 0x0050, 0x0070 }, { 0x0051, 0x0071 },
+	{ 0x0052, 0x0072 }, { 0x0053, 0x0073 }, { 0x0054, 0x0074 }, { 0x0055, 0x0075 },
+	{ 0x0056, 0x0076 }, { 0x0057, 0x0077 }, { 0x0058, 0x0078 }, { 0x0059, 0x0079 },
+	{ 0x005a, 0x007a }, { 0x00c0, 0x00e0 }, { 0x00c1, 0x00e1 }, { 0x00c2, 0x00e2 },
+	{ 0x00c3, 0x00e3 }, { 0x00c4, 0x00e4 }, { 0x00c5, 0x00e5 }, { 0x00c6, 0x00e6 },
+	{ 0x00c7, 0x00e7 }, { 0x00c8, 0x00e8 }, { 0x00c9, 0x00e9 }, { 0x00ca, 0x00ea },
+	{ 0x00cb, 0x00eb }, { 0x00cc, 0x00ec }, { 0x00cd, 0x00ed }, { 0x00ce, 0x00ee },
+	{ 0x00cf, 0x00ef }, { 0x00d0, 0x00f0 }, { 0x00d1, 0x00f1 }, { 0x00d2, 0x00f2 },
+	{ 0x00d3, 0x00f3 }, { 0x00d4, 0x00f4 }, { 0x00d5, 0x00f5 }, { 0x00d6, 0x00f6 },
+	{ 0x00d8, 0x00f8 }, { 0x00d9, 0x00f9 }, { 0x00da, 0x00fa }, { 0x00db, 0x00fb },
+	{ 0x00dc, 0x00fc }, { 0x00dd, 0x00fd }, { 0x00de, 0x00fe }, { 0x0100, 0x0101 },
+	{ 0x0102, 0x0103 }, { 0x0104, 0x0105 }, { 0x0106, 0x0107 }, { 0x0108, 0x0109 },
+	{ 0x010a, 0x010b }, { 0x010c, 0x010d }, { 0x010e, 0x010f }, { 0x0110, 0x0111 },
+	{ 0x0112, 0x0113 }, { 0x0114, 0x0115 }, { 0x0116, 0x0117 }, { 0x0118, 0x0119 },
+	{ 0x011a, 0x011b }, { 0x011c, 0x011d }, { 0x011e, 0x011f }, { 0x0120, 0x0121 },
+	{ 0x0122, 0x0123 }, { 0x0124, 0x0125 }, { 0x0126, 0x0127 }, { 0x0128, 0x0129 },
+	{ 0x012a, 0x012b }, { 0x012c, 0x012d }, { 0x012e, 0x012f }, { 0x0130, 0x0069 },
+	{ 0x0132, 0x0133 }, { 0x0134, 0x0135 }, { 0x0136, 0x0137 }, { 0x0139, 0x013a },
+	{ 0x013b, 0x013c }, { 0x013d, 0x013e }, { 0x013f, 0x0140 }, { 0x0141, 0x0142 },
+	{ 0x0143, 0x0144 }, { 0x0145, 0x0146 }, { 0x0147, 0x0148 }, { 0x014a, 0x014b },
+	{ 0x014c, 0x014d }, { 0x014e, 0x014f }, { 0x0150, 0x0151 }, { 0x0152, 0x0153 },
+	{ 0x0154, 0x0155 }, { 0x0156, 0x0157 }, { 0x0158, 0x0159 }, { 0x015a, 0x015b },
+	{ 0x015c, 0x015d }, { 0x015e, 0x015f }, { 0x0160, 0x0161 }, { 0x0162, 0x0163 },
+	{ 0x0164, 0x0165 }, { 0x0166, 0x0167 }, { 0x0168, 0x0169 }, { 0x016a, 0x016b },
+	{ 0x016c, 0x016d }, { 0x016e, 0x016f }, { 0x0170, 0x0171 }, { 0x0172, 0x0173 },
+	{ 0x0174, 0x0175 }, { 0x0176, 0x0177 }, { 0x0178, 0x00ff }, { 0x0179, 0x017a },
+	{ 0x017b, 0x017c }, { 0x017d, 0x017e }, { 0x0181, 0x0253 }, { 0x0182, 0x0183 },
+	{ 0x0184, 0x0185 }, { 0x0186, 0x0254 }, { 0x0187, 0x0188 }, { 0x0189, 0x0256 },
+	{ 0x018a, 0x0257 }, { 0x018b, 0x018c }, { 0x018e, 0x01dd }, { 0x018f, 0x0259 },
+	{ 0x0190, 0x025b }, { 0x0191, 0x0192 }, { 0x0193, 0x0260 }, { 0x0194, 0x0263 },
+	{ 0x0196, 0x0269 }, { 0x0197, 0x0268 }, { 0x0198, 0x0199 }, { 0x019c, 0x026f },
+	{ 0x019d, 0x0272 }, { 0x019f, 0x0275 }, { 0x01a0, 0x01a1 }, { 0x01a2, 0x01a3 },
+	{ 0x01a4, 0x01a5 }, { 0x01a6, 0x0280 }, { 0x01a7, 0x01a8 }, { 0x01a9, 0x0283 },
+	{ 0x01ac, 0x01ad }, { 0x01ae, 0x0288 }, { 0x01af, 0x01b0 }, { 0x01b1, 0x028a },
+	{ 0x01b2, 0x028b }, { 0x01b3, 0x01b4 }, { 0x01b5, 0x01b6 }, { 0x01b7, 0x0292 },
+	{ 0x01b8, 0x01b9 }, { 0x01bc, 0x01bd }, { 0x01c4, 0x01c6 }, { 0x01c5, 0x01c6 },
+	{ 0x01c7, 0x01c9 }, { 0x01c8, 0x01c9 }, { 0x01ca, 0x01cc }, { 0x01cb, 0x01cc },
+	{ 0x01cd, 0x01ce }, { 0x01cf, 0x01d0 }, { 0x01d1, 0x01d2 }, { 0x01d3, 0x01d4 },
+	{ 0x01d5, 0x01d6 }, { 0x01d7, 0x01d8 }, { 0x01d9, 0x01da }, { 0x01db, 0x01dc },
+	{ 0x01de, 0x01df }, { 0x01e0, 0x01e1 }, { 0x01e2, 0x01e3 }, { 0x01e4, 0x01e5 },
+	{ 0x01e6, 0x01e7 }, { 0x01e8, 0x01e9 }, { 0x01ea, 0x01eb }, { 0x01ec, 0x01ed },
+	{ 0x01ee, 0x01ef }, { 0x01f1, 0x01f3 }, { 0x01f2, 0x01f3 }, { 0x01f4, 0x01f5 },
+	{ 0x01f6, 0x0195 }, { 0x01f7, 0x01bf }, { 0x01f8, 0x01f9 }, { 0x01fa, 0x01fb },
+	{ 0x01fc, 0x01fd }, { 0x01fe, 0x01ff }, { 0x0200, 0x0201 }, { 0x0202, 0x0203 },
+	{ 0x0204, 0x0205 }, { 0x0206, 0x0207 }, { 0x0208, 0x0209 }, { 0x020a, 0x020b },
+	{ 0x020c, 0x020d }, { 0x020e, 0x020f }, { 0x0210, 0x0211 }, { 0x0212, 0x0213 },
+	{ 0x0214, 0x0215 }, { 0x0216, 0x0217 }, { 0x0218, 0x0219 }, { 0x021a, 0x021b },
+	{ 0x021c, 0x021d }, { 0x021e, 0x021f }, { 0x0220, 0x019e }, { 0x0222, 0x0223 },
+	{ 0x0224, 0x0225 }, { 0x0226, 0x0227 }, { 0x0228, 0x0229 }, { 0x022a, 0x022b },
+	{ 0x022c, 0x022d }, { 0x022e, 0x022f }, { 0x0230, 0x0231 }, { 0x0232, 0x0233 },
+	{ 0x023a, 0x2c65 }, { 0x023b, 0x023c }, { 0x023d, 0x019a }, { 0x023e, 0x2c66 },
+	{ 0x0241, 0x0242 }, { 0x0243, 0x0180 }, { 0x0244, 0x0289 }, { 0x0245, 0x028c },
+	{ 0x0246, 0x0247 }, { 0x0248, 0x0249 }, { 0x024a, 0x024b }, { 0x024c, 0x024d },
+	{ 0x024e, 0x024f }, { 0x1e00, 0x1e01 }, { 0x1e02, 0x1e03 }, { 0x1e04, 0x1e05 },
+	{ 0x1e06, 0x1e07 }, { 0x1e08, 0x1e09 }, { 0x1e0a, 0x1e0b }, { 0x1e0c, 0x1e0d },
+	{ 0x1e0e, 0x1e0f }, { 0x1e10, 0x1e11 }, { 0x1e12, 0x1e13 }, { 0x1e14, 0x1e15 },
+	{ 0x1e16, 0x1e17 }, { 0x1e18, 0x1e19 }, { 0x1e1a, 0x1e1b }, { 0x1e1c, 0x1e1d },
+	{ 0x1e1e, 0x1e1f }, { 0x1e20, 0x1e21 }, { 0x1e22, 0x1e23 }, { 0x1e24, 0x1e25 },
+	{ 0x1e26, 0x1e27 }, { 0x1e28, 0x1e29 }, { 0x1e2a, 0x1e2b }, { 0x1e2c, 0x1e2d },
+	{ 0x1e2e, 0x1e2f }, { 0x1e30, 0x1e31 }, { 0x1e32, 0x1e33 }, { 0x1e34, 0x1e35 },
+	{ 0x1e36, 0x1e37 }, { 0x1e38, 0x1e39 }, { 0x1e3a, 0x1e3b }, { 0x1e3c, 0x1e3d },
+	{ 0x1e3e, 0x1e3f }, { 0x1e40, 0x1e41 }, { 0x1e42, 0x1e43 }, { 0x1e44, 0x1e45 },
+	{ 0x1e46, 0x1e47 }, { 0x1e48, 0x1e49 }, { 0x1e4a, 0x1e4b }, { 0x1e4c, 0x1e4d },
+	{ 0x1e4e, 0x1e4f }, { 0x1e50, 0x1e51 }, { 0x1e52, 0x1e53 }, { 0x1e54, 0x1e55 },
+	{ 0x1e56, 0x1e57 }, { 0x1e58, 0x1e59 }, { 0x1e5a, 0x1e5b }, { 0x1e5c, 0x1e5d },
+	{ 0x1e5e, 0x1e5f }, { 0x1e60, 0x1e61 }, { 0x1e62, 0x1e63 }, { 0x1e64, 0x1e65 },
+	{ 0x1e66, 0x1e67 }, { 0x1e68, 0x1e69 }, { 0x1e6a, 0x1e6b }, { 0x1e6c, 0x1e6d },
+	{ 0x1e6e, 0x1e6f }, { 0x1e70, 0x1e71 }, { 0x1e72, 0x1e73 }, { 0x1e74, 0x1e75 },
+	{ 0x1e76, 0x1e77 }, { 0x1e78, 0x1e79 }, { 0x1e7a, 0x1e7b }, { 0x1e7c, 0x1e7d },
+	{ 0x1e7e, 0x1e7f }, { 0x1e80, 0x1e81 }, { 0x1e82, 0x1e83 }, { 0x1e84, 0x1e85 },
+	{ 0x1e86, 0x1e87 }, { 0x1e88, 0x1e89 }, { 0x1e8a, 0x1e8b }, { 0x1e8c, 0x1e8d },
+	{ 0x1e8e, 0x1e8f }, { 0x1e90, 0x1e91 }, { 0x1e92, 0x1e93 }, { 0x1e94, 0x1e95 },
+	{ 0x1e9e, 0x00df }, { 0x1ea0, 0x1ea1 }, { 0x1ea2, 0x1ea3 }, { 0x1ea4, 0x1ea5 },
+	{ 0x1ea6, 0x1ea7 }, { 0x1ea8, 0x1ea9 }, { 0x1eaa, 0x1eab }, { 0x1eac, 0x1ead },
+	{ 0x1eae, 0x1eaf }, { 0x1eb0, 0x1eb1 }, { 0x1eb2, 0x1eb3 }, { 0x1eb4, 0x1eb5 },
+	{ 0x1eb6, 0x1eb7 }, { 0x1eb8, 0x1eb9 }, { 0x1eba, 0x1ebb }, { 0x1ebc, 0x1ebd },
+	{ 0x1ebe, 0x1ebf }, { 0x1ec0, 0x1ec1 }, { 0x1ec2, 0x1ec3 }, { 0x1ec4, 0x1ec5 },
+	{ 0x1ec6, 0x1ec7 }, { 0x1ec8, 0x1ec9 }, { 0x1eca, 0x1ecb }, { 0x1ecc, 0x1ecd },
+	{ 0x1ece, 0x1ecf }, { 0x1ed0, 0x1ed1 }, { 0x1ed2, 0x1ed3 }, { 0x1ed4, 0x1ed5 },
+	{ 0x1ed6, 0x1ed7 }, { 0x1ed8, 0x1ed9 }, { 0x1eda, 0x1edb }, { 0x1edc, 0x1edd },
+	{ 0x1ede, 0x1edf }, { 0x1ee0, 0x1ee1 }, { 0x1ee2, 0x1ee3 }, { 0x1ee4, 0x1ee5 },
+	{ 0x1ee6, 0x1ee7 }, { 0x1ee8, 0x1ee9 }, { 0x1eea, 0x1eeb }, { 0x1eec, 0x1eed },
+	{ 0x1eee, 0x1eef }, { 0x1ef0, 0x1ef1 }, { 0x1ef2, 0x1ef3 }, { 0x1ef4, 0x1ef5 },
+	{ 0x1ef6, 0x1ef7 }, { 0x1ef8, 0x1ef9 }, { 0x1efa, 0x1efb }, { 0x1efc, 0x1efd },
+	{ 0x1efe, 0x1eff },
+};
+
+/* ldig.vietnamese_norm : (base, combining mark) => precomposed */
+static const unsigned short vietnameseTbl[][3] = {
+	{ 0x0041, 0x0300, 0x00c0 }, { 0x0041, 0x0301, 0x00c1 }, { 0x0041, 0x0303, 0x00c3 },
+	{ 0x0041, 0x0309, 0x1ea2 }, { 0x0041, 0x0323, 0x1ea0 }, { 0x0045, 0x0300, 0x00c8 },
+	{ 0x0045, 0x0301, 0x00c9 }, { 0x0045, 0x0303, 0x1ebc }, { 0x0045, 0x0309, 0x1eba },
+	{ 0x0045, 0x0323, 0x1eb8 }, { 0x0049, 0x0300, 0x00cc }, { 0x0049, 0x0301, 0x00cd },
+	{ 0x0049, 0x0303, 0x0128 }, { 0x0049, 0x0309, 0x1ec8 }, { 0x0049, 0x0323, 0x1eca },
+	{ 0x004f, 0x0300, 0x00d2 }, { 0x004f, 0x0301, 0x00d3 }, { 0x004f, 0x0303, 0x00d5 },
+	{ 0x004f, 0x0309, 0x1ece }, { 0x004f, 0x0323, 0x1ecc }, { 0x0055, 0x0300, 0x00d9 },
+	{ 0x0055, 0x0301, 0x00da }, { 0x0055, 0x0303, 0x0168 }, { 0x0055, 0x0309, 0x1ee6 },
+	{ 0x0055, 0x0323, 0x1ee4 }, { 0x0059, 0x0300, 0x1ef2 }, { 0x0059, 0x0301, 0x00dd },
+	{ 0x0059, 0x0303, 0x1ef8 }, { 0x0059, 0x0309, 0x1ef6 }, { 0x0059, 0x0323, 0x1ef4 },
+	{ 0x0061, 0x0300, 0x00e0 }, { 0x0061, 0x0301, 0x00e1 }, { 0x0061, 0x0303, 0x00e3 },
+	{ 0x0061, 0x0309, 0x1ea3 }, { 0x0061, 0x0323, 0x1ea1 }, { 0x0065, 0x0300, 0x00e8 },
+	{ 0x0065, 0x0301, 0x00e9 }, { 0x0065, 0x0303, 0x1ebd }, { 0x0065, 0x0309, 0x1ebb },
+	{ 0x0065, 0x0323, 0x1eb9 }, { 0x0069, 0x0300, 0x00ec }, { 0x0069, 0x0301, 0x00ed },
+	{ 0x0069, 0x0303, 0x0129 }, { 0x0069, 0x0309, 0x1ec9 }, { 0x0069, 0x0323, 0x1ecb },
+	{ 0x006f, 0x0300, 0x00f2 }, { 0x006f, 0x0301, 0x00f3 }, { 0x006f, 0x0303, 0x00f5 },
+	{ 0x006f, 0x0309, 0x1ecf }, { 0x006f, 0x0323, 0x1ecd }, { 0x0075, 0x0300, 0x00f9 },
+	{ 0x0075, 0x0301, 0x00fa }, { 0x0075, 0x0303, 0x0169 }, { 0x0075, 0x0309, 0x1ee7 },
+	{ 0x0075, 0x0323, 0x1ee5 }, { 0x0079, 0x0300, 0x1ef3 }, { 0x0079, 0x0301, 0x00fd },
+	{ 0x0079, 0x0303, 0x1ef9 }, { 0x0079, 0x0309, 0x1ef7 }, { 0x0079, 0x0323, 0x1ef5 },
+	{ 0x00c2, 0x0300, 0x1ea6 }, { 0x00c2, 0x0301, 0x1ea4 }, { 0x00c2, 0x0303, 0x1eaa },
+	{ 0x00c2, 0x0309, 0x1ea8 }, { 0x00c2, 0x0323, 0x1eac }, { 0x00ca, 0x0300, 0x1ec0 },
+	{ 0x00ca, 0x0301, 0x1ebe }, { 0x00ca, 0x0303, 0x1ec4 }, { 0x00ca, 0x0309, 0x1ec2 },
+	{ 0x00ca, 0x0323, 0x1ec6 }, { 0x00d4, 0x0300, 0x1ed2 }, { 0x00d4, 0x0301, 0x1ed0 },
+	{ 0x00d4, 0x0303, 0x1ed6 }, { 0x00d4, 0x0309, 0x1ed4 }, { 0x00d4, 0x0323, 0x1ed8 },
+	{ 0x00e2, 0x0300, 0x1ea7 }, { 0x00e2, 0x0301, 0x1ea5 }, { 0x00e2, 0x0303, 0x1eab },
+	{ 0x00e2, 0x0309, 0x1ea9 }, { 0x00e2, 0x0323, 0x1ead }, { 0x00ea, 0x0300, 0x1ec1 },
+	{ 0x00ea, 0x0301, 0x1ebf }, { 0x00ea, 0x0303, 0x1ec5 }, { 0x00ea, 0x0309, 0x1ec3 },
+	{ 0x00ea, 0x0323, 0x1ec7 }, { 0x00f4, 0x0300, 0x1ed3 }, { 0x00f4, 0x0301, 0x1ed1 },
+	{ 0x00f4, 0x0303, 0x1ed7 }, { 0x00f4, 0x0309, 0x1ed5 }, { 0x00f4, 0x0323, 0x1ed9 },
+	{ 0x0102, 0x0300, 0x1eb0 }, { 0x0102, 0x0301, 0x1eae }, { 0x0102, 0x0303, 0x1eb4 },
+	{ 0x0102, 0x0309, 0x1eb2 }, { 0x0102, 0x0323, 0x1eb6 }, { 0x0103, 0x0300, 0x1eb1 },
+	{ 0x0103, 0x0301, 0x1eaf }, { 0x0103, 0x0303, 0x1eb5 }, { 0x0103, 0x0309, 0x1eb3 },
+	{ 0x0103, 0x0323, 0x1eb7 }, { 0x01a0, 0x0300, 0x1edc }, { 0x01a0, 0x0301, 0x1eda },
+	{ 0x01a0, 0x0303, 0x1ee0 }, { 0x01a0, 0x0309, 0x1ede }, { 0x01a0, 0x0323, 0x1ee2 },
+	{ 0x01a1, 0x0300, 0x1edd }, { 0x01a1, 0x0301, 0x1edb }, { 0x01a1, 0x0303, 0x1ee1 },
+	{ 0x01a1, 0x0309, 0x1edf }, { 0x01a1, 0x0323, 0x1ee3 }, { 0x01af, 0x0300, 0x1eea },
+	{ 0x01af, 0x0301, 0x1ee8 }, { 0x01af, 0x0303, 0x1eee }, { 0x01af, 0x0309, 0x1eec },
+	{ 0x01af, 0x0323, 0x1ef0 }, { 0x01b0, 0x0300, 0x1eeb }, { 0x01b0, 0x0301, 0x1ee9 },
+	{ 0x01b0, 0x0303, 0x1eef }, { 0x01b0, 0x0309, 0x1eed }, { 0x01b0, 0x0323, 0x1ef1 },
+};
+
+const Char lowerMax = 0x1f00;
+
+struct LowerMap {
+	Char tbl[lowerMax];
+	LowerMap()
+	{
+		for (Char c = 0; c < lowerMax; c++) tbl[c] = c;
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(lowerTbl); i++) {
+			tbl[lowerTbl[i][0]] = lowerTbl[i][1];
+		}
+	}
+};
+
+inline const Char *getLowerMap()
+{
+	static const LowerMap map;
+	return map.tbl;
+}
+
+inline bool isAllowed(Char c)
+{
+	return (0x20 <= c && c <= 0x7e) || (0xa1 <= c && c <= 0x24f)
+		|| (0x300 <= c && c <= 0x36f) || (0x1e00 <= c && c <= 0x1eff);
+}
+inline bool isLatin(Char c) { return ('a' <= c && c <= 'z') || (0xe0 <= c && c <= 0x24f); }
+inline bool isDigit(Char c) { return '0' <= c && c <= '9'; }
+inline bool isAlpha(Char c) { return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z'); }
+inline bool isHex(Char c) { return isDigit(c) || ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F'); }
+inline bool isVowel(Char c) { return c == 'a' || c == 'i' || c == 'e' || c == 'o'; }
+
+inline bool startsWith(const String& s, size_t pos, const char *p)
+{
+	for (; *p; p++, pos++) {
+		if (pos >= s.size() || s[pos] != (Char)*p) return false;
+	}
+	return true;
+}
+
+inline int findEntity(const std::string& name)
+{
+	size_t lo = 0, hi = CYBOZU_NUM_OF_ARRAY(entityTbl);
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		int r = strcmp(entityTbl[mid].name, name.c_str());
+		if (r == 0) return entityTbl[mid].code;
+		if (r < 0) lo = mid + 1; else hi = mid;
+	}
+	return -1;
+}
+
+/* parse digits of s[begin, end) in radix, -1 if invalid (python raises) */
+inline long parseNumber(const String& s, size_t begin, size_t end, int radix)
+{
+	long v = 0;
+	for (size_t i = begin; i < end; i++) {
+		Char c = s[i];
+		int d;
+		if (isDigit(c)) d = c - '0';
+		else if (radix == 16 && isHex(c)) d = (c | 0x20) - 'a' + 10;
+		else return -1;
+		v = v * radix + d;
+		if (v > 0x10ffff) return -1;
+	}
+	return v;
+}
+
+/* htmlentity2unicode : &(#x?[0-9a-f]+|[a-z]+); (ignore case) */
+inline void htmlentity(String& out, const String& s)
+{
+	const size_t n = s.size();
+	out.clear();
+	size_t i = 0;
+	while (i < n) {
+		if (s[i] != '&') {
+			out.push_back(s[i++]);
+			continue;
+		}
+		size_t begin = i + 1, end = 0;
+		if (begin < n && s[begin] == '#') {
+			size_t k = begin + 1;
+			if (k < n && (s[k] == 'x' || s[k] == 'X')) {
+				size_t h = k + 1;
+				while (h < n && isHex(s[h])) h++;
+				if (h > k + 1 && h < n && s[h] == ';') end = h;
+			}
+			if (end == 0) {
+				size_t h = k;
+				while (h < n && isHex(s[h])) h++;
+				if (h > k && h < n && s[h] == ';') end = h;
+			}
+		} else {
+			size_t h = begin;
+			while (h < n && isAlpha(s[h])) h++;
+			if (h > begin && h < n && s[h] == ';') end = h;
+		}
+		if (end == 0) {
+			out.push_back(s[i++]);
+			continue;
+		}
+		long code = -1;
+		if (s[begin] == '#') {
+			if (end - begin > 2 && (s[begin + 1] == 'x' || s[begin + 1] == 'X') && isDigit(s[begin + 2])) {
+				code = parseNumber(s, begin + 2, end, 16);
+			} else if (isDigit(s[begin + 1])) {
+				code = parseNumber(s, begin + 1, end, 10);
+			}
+		} else {
+			std::string name;
+			for (size_t j = begin; j < end; j++) name += (char)s[j];
+			code = findEntity(name);
+		}
+		if (code >= 0) out.push_back((Char)code);
+		i = end + 1;
+	}
+}
+
+/*
+	[‐-―] => '-', [0-9]+ => '0',
+	characters out of range => ' ', '  +' => ' '
+*/
+inline void filterChars(String& out, const String& s)
+{
+	const size_t n = s.size();
+	out.clear();
+	size_t i = 0;
+	while (i < n) {
+		Char c = s[i];
+		if (0x2010 <= c && c <= 0x2015) c = '-';
+		if (isDigit(c)) {
+			while (i < n && isDigit(s[i])) i++;
+			c = '0';
+		} else if (!isAllowed(c)) {
+			while (i < n && !isAllowed(s[i]) && !(0x2010 <= s[i] && s[i] <= 0x2015)) i++;
+			c = ' ';
+		} else {
+			i++;
+		}
+		if (c == ' ' && !out.empty() && out[out.size() - 1] == ' ') continue;
+		out.push_back(c);
+	}
+}
+
+/* vietnamese normalization, lower case except 'I', romanian normalization */
+inline void foldChars(String& out, const String& s)
+{
+	const Char *lower = getLowerMap();
+	const size_t n = s.size();
+	out.clear();
+	for (size_t i = 0; i < n; i++) {
+		Char c = s[i];
+		if (i + 1 < n && 0x300 <= s[i + 1] && s[i + 1] <= 0x323) {
+			for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(vietnameseTbl); j++) {
+				if (vietnameseTbl[j][0] == c && vietnameseTbl[j][1] == s[i + 1]) {
+					c = vietnameseTbl[j][2];
+					i++;
+					break;
+				}
+			}
+		}
+		if (c != 'I' && c < lowerMax) c = lower[c];
+		if (c == 0x219) c = 0x15f;
+		if (c == 0x21b) c = 0x163;
+		out.push_back(c);
+	}
+}
+
+/* (@|#|https?:\/\/)[^ ]+ => '' */
+inline void removeEntities(String& out, const String& s)
+{
+	const size_t n = s.size();
+	out.clear();
+	for (size_t i = 0; i < n; ) {
+		size_t p = 0;
+		if (s[i] == '@' || s[i] == '#') {
+			p = i + 1;
+		} else if (startsWith(s, i, "http://")) {
+			p = i + 7;
+		} else if (startsWith(s, i, "https://")) {
+			p = i + 8;
+		}
+		if (p > 0 && p < n && s[p] != ' ') {
+			while (p < n && s[p] != ' ') p++;
+			i = p;
+		} else {
+			out.push_back(s[i++]);
+		}
+	}
+}
+
+/* (^| )[:;x]-?[\(\)dop]($| ) => ' ' */
+inline void removeFacemarks(String& out, const String& s)
+{
+	const size_t n = s.size();
+	out.clear();
+	for (size_t i = 0; i < n; ) {
+		size_t end = 0;
+		for (int alt = 0; alt < 2 && end == 0; alt++) {
+			size_t j;
+			if (alt == 0) {
+				if (i != 0) continue;
+				j = i;
+			} else {
+				if (s[i] != ' ') continue;
+				j = i + 1;
+			}
+			if (j >= n || (s[j] != ':' && s[j] != ';' && s[j] != 'x')) continue;
+			j++;
+			if (j < n && s[j] == '-') j++;
+			if (j >= n || (s[j] != '(' && s[j] != ')' && s[j] != 'd' && s[j] != 'o' && s[j] != 'p')) continue;
+			j++;
+			if (j == n) {
+				end = j;
+			} else if (s[j] == ' ') {
+				end = j + 1;
+			}
+		}
+		if (end > 0) {
+			out.push_back(' ');
+			i = end;
+		} else {
+			out.push_back(s[i++]);
+		}
+	}
+}
+
+/* skip (rt[ :]+)* */
+inline size_t skipRetweets(const String& s, size_t i)
+{
+	const size_t n = s.size();
+	while (i + 2 < n && s[i] == 'r' && s[i + 1] == 't' && (s[i + 2] == ' ' || s[i + 2] == ':')) {
+		i += 2;
+		while (i < n && (s[i] == ' ' || s[i] == ':')) i++;
+	}
+	return i;
+}
+
+/*
+	(^| )(rt[ :]+)* => ' '
+	same as re.sub of python 2, which matches '^' (maybe empty) at the head
+	and does not retry the head position as ' '.
+*/
+inline void removeRetweets(String& out, const String& s)
+{
+	const size_t n = s.size();
+	out.clear();
+	out.push_back(' ');
+	size_t i = skipRetweets(s, 0);
+	if (i == 0 && n > 0) out.push_back(s[i++]);
+	while (i < n) {
+		if (s[i] == ' ') {
+			out.push_back(' ');
+			i = skipRetweets(s, i + 1);
+		} else {
+			out.push_back(s[i++]);
+		}
+	}
+}
+
+/* ([hj])+([aieo])+(\1+\2+){1,} => \1\2\1\2 (at most 2 times) */
+inline void shortenLaughs(String& out, const String& s)
+{
+	const size_t n = s.size();
+	out.clear();
+	int count = 0;
+	for (size_t i = 0; i < n; ) {
+		if (count >= 2 || (s[i] != 'h' && s[i] != 'j')) {
+			out.push_back(s[i++]);
+			continue;
+		}
+		size_t p = i;
+		while (p < n && (s[p] == 'h' || s[p] == 'j')) p++;
+		size_t q = p;
+		while (q < n && isVowel(s[q])) q++;
+		if (q > p) {
+			const Char c1 = s[p - 1], c2 = s[q - 1];
+			size_t r = q;
+			for (;;) {
+				size_t a = r;
+				while (a < n && s[a] == c1) a++;
+				if (a == r) break;
+				size_t b = a;
+				while (b < n && s[b] == c2) b++;
+				if (b == a) break;
+				r = b;
+			}
+			if (r > q) {
+				out.push_back(c1); out.push_back(c2);
+				out.push_back(c1); out.push_back(c2);
+				count++;
+				i = r;
+				continue;
+			}
+		}
+		/* no match can start in this [hj] run */
+		while (i < p) out.push_back(s[i++]);
+	}
+}
+
+/* ' +(via|live on) *$' => '' */
+inline void removeTrailer(String& s)
+{
+	size_t k = s.size();
+	while (k > 0 && s[k - 1] == ' ') k--;
+	size_t w;
+	if (k >= 3 && startsWith(s, k - 3, "via")) {
+		w = k - 3;
+	} else if (k >= 7 && startsWith(s, k - 7, "live on")) {
+		w = k - 7;
+	} else {
+		return;
+	}
+	if (w == 0 || s[w - 1] != ' ') return;
+	while (w > 0 && s[w - 1] == ' ') w--;
+	s.resize(w);
+}
+
+/*
+	([a-zà-ɏ])\1{2,} => \1\1
+	([^a-zà-ɏ])\1{1,} => \1
+	and strip()
+*/
+inline void shortenRepeats(String& out, const String& s)
+{
+	const size_t n = s.size();
+	out.clear();
+	for (size_t i = 0; i < n; ) {
+		const Char c = s[i];
+		size_t j = i + 1;
+		while (j < n && s[j] == c) j++;
+		out.push_back(c);
+		if (j - i >= 2 && isLatin(c)) out.push_back(c);
+		i = j;
+	}
+	size_t b = 0, e = out.size();
+	while (b < e && out[b] == ' ') b++;
+	while (e > b && out[e - 1] == ' ') e--;
+	out = String(out, b, e - b);
+}
+
+} // normalize_local
+
+/**
+	decode UTF-8 into code points (invalid bytes become U+FFFD)
+	@param out [out] decoded string
+	@param begin [in] begin of UTF-8 text
+	@param end [in] end of UTF-8 text
+*/
+inline void decodeUtf8(cybozu::String& out, const char *begin, const char *end)
+{
+	out.clear();
+	out.reserve(end - begin);
+	while (begin != end) {
+		cybozu::Char c;
+		const char *p = begin;
+		if (cybozu::string::GetCharFromUtf8(&c, begin, end)) {
+			out.push_back(c);
+		} else {
+			out.push_back(0xfffd);
+			begin = p + 1;
+		}
+	}
+}
+
+/**
+	normalize one line of corpus the same as ldig.normalize_text
+	@param label [out] label ("" if the line has no label)
+	@param text [out] normalized text
+	@param org [out] original text (after the label)
+	@param line [in] one line of UTF-8 text without '\n'
+	@param hasNewline [in] the line was read from a file with '\n'
+	@note normalize_text sees the trailing '\n' of unlabeled lines
+*/
+inline void normalizeText(std::string& label, cybozu::String& text, std::string& org, const std::string& line, bool hasNewline = true)
+{
+	using namespace normalize_local;
+	label.clear();
+	size_t p = 0;
+	while (p < line.size() && (isAlpha((unsigned char)line[p]) || line[p] == '-')) p++;
+	if (p > 0 && p + 1 < line.size() && line[p] == '\t') {
+		label.assign(line, 0, p);
+		org.assign(line, p + 1, std::string::npos);
+		hasNewline = false;
+	} else {
+		org = line;
+	}
+	size_t tab = org.rfind('\t');
+	const char *top = org.c_str();
+	if (tab != std::string::npos && (tab + 1 < org.size() || hasNewline)) top += tab;
+
+	String s, t;
+	decodeUtf8(s, top, org.c_str() + org.size());
+	if (hasNewline) s.push_back('\n');
+	htmlentity(t, s);
+	filterChars(s, t);
+	foldChars(t, s);
+	removeEntities(s, t);
+	removeFacemarks(t, s);
+	removeRetweets(s, t);
+	shortenLaughs(t, s);
+	removeTrailer(t);
+	shortenRepeats(text, t);
+}
+
+} // ldig
@@ -0,0 +1,341 @@
+#pragma once
+/**
+	@file
+	@brief minimal reader/writer of numpy .npy/.npz files
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <stdio.h>
+#include "cybozu/exception.hpp"
+#include "cybozu/inttype.hpp"
+#include "../maxsubst/gzip.hpp"
+
+namespace ldig {
+
+struct NpyException : public cybozu::Exception {
+	NpyException() : cybozu::Exception("npy") { }
+};
+
+/**
+	read whole file into buf
+*/
+inline void readFile(std::string& buf, const std::string& path)
+{
+	std::ifstream ifs(path.c_str(), std::ios::binary);
+	if (!ifs) {
+		NpyException e;
+		e << "can't open" << path;
+		throw e;
+	}
+	ifs.seekg(0, std::ios::end);
+	buf.resize((size_t)ifs.tellg());
+	ifs.seekg(0, std::ios::beg);
+	if (!buf.empty()) ifs.read(&buf[0], buf.size());
+}
+
+namespace npy {
+
+/**
+	one array of .npy (only C order, little endian is supported)
+*/
+struct Array {
+	std::string descr; //!< '<f8', '<i4', ...
+	std::vector<size_t> shape;
+	std::string data;
+
+	size_t size() const
+	{
+		size_t n = 1;
+		for (size_t i = 0; i < shape.size(); i++) n *= shape[i];
+		return n;
+	}
+	/**
+		convert data into vector<T>
+	*/
+	template<class T>
+	void get(std::vector<T>& out) const
+	{
+		const size_t n = size();
+		out.resize(n);
+		const char *p = data.data();
+		if (descr == "<f8") {
+			for (size_t i = 0; i < n; i++) { double v; memcpy(&v, p + i * 8, 8); out[i] = (T)v; }
+		} else if (descr == "<f4") {
+			for (size_t i = 0; i < n; i++) { float v; memcpy(&v, p + i * 4, 4); out[i] = (T)v; }
+		} else if (descr == "<i8") {
+			for (size_t i = 0; i < n; i++) { int64_t v; memcpy(&v, p + i * 8, 8); out[i] = (T)v; }
+		} else if (descr == "<i4") {
+			for (size_t i = 0; i < n; i++) { int32_t v; memcpy(&v, p + i * 4, 4); out[i] = (T)v; }
+		} else {
+			NpyException e;
+			e << "unsupported dtype" << descr;
+			throw e;
+		}
+	}
+};
+
+namespace local {
+
+inline uint32_t get16(const char *p) { return (unsigned char)p[0] | ((unsigned char)p[1] << 8); }
+inline uint32_t get32(const char *p) { return get16(p) | (get16(p + 2) << 16); }
+inline uint64_t get64(const char *p) { return get32(p) | ((uint64_t)get32(p + 4) << 32); }
+
+/* get the value string of 'key' in header dict */
+inline std::string getValue(const std::string& header, const char *key)
+{
+	std::string k = std::string("'") + key + "'";
+	size_t p = header.find(k);
+	if (p == std::string::npos) {
+		NpyException e;
+		e << "no key in header" << key;
+		throw e;
+	}
+	p = header.find(':', p) + 1;
+	while (header[p] == ' ') p++;
+	size_t q = p;
+	if (header[p] == '(') {
+		q = header.find(')', p) + 1;
+	} else if (header[p] == '\'') {
+		q = header.find('\'', p + 1) + 1;
+	} else {
+		while (q < header.size() && header[q] != ',' && header[q] != '}') q++;
+	}
+	return header.substr(p, q - p);
+}
+
+} // local
+
+/**
+	parse .npy image
+	@param a [out] array
+	@param p [in] top of .npy image
+	@param n [in] size of image
+*/
+inline void parse(Array& a, const char *p, size_t n)
+{
+	if (n < 10 || memcmp(p, "\x93NUMPY", 6) != 0) throw NpyException() << "bad magic";
+	size_t headerLen, top;
+	if (p[6] == 1) {
+		headerLen = local::get16(p + 8);
+		top = 10;
+	} else {
+		headerLen = local::get32(p + 8);
+		top = 12;
+	}
+	if (top + headerLen > n) throw NpyException() << "bad header";
+	const std::string header(p + top, headerLen);
+	std::string descr = local::getValue(header, "descr");
+	a.descr = descr.substr(1, descr.size() - 2);
+	if (local::getValue(header, "fortran_order") != "False") throw NpyException() << "fortran order is not supported";
+	const std::string shape = local::getValue(header, "shape");
+	a.shape.clear();
+	for (size_t i = 1; i < shape.size(); ) {
+		if ('0' <= shape[i] && shape[i] <= '9') {
+			char *end;
+			a.shape.push_back(strtoul(shape.c_str() + i, &end, 10));
+			i = end - shape.c_str();
+		} else {
+			i++;
+		}
+	}
+	const size_t itemSize = atoi(a.descr.c_str() + 2);
+	const size_t body = top + headerLen;
+	if (n - body < a.size() * itemSize) throw NpyException() << "short data";
+	a.data.assign(p + body, a.size() * itemSize);
+}
+
+/**
+	load .npy file
+*/
+inline void load(Array& a, const std::string& path)
+{
+	std::string buf;
+	readFile(buf, path);
+	parse(a, buf.data(), buf.size());
+}
+
+/**
+	load arrays of .npz file (numpy.savez, not compressed)
+	@param arrays [out] name(without .npy) => array
+	@param path [in] .npz file
+*/
+inline void loadNpz(std::map<std::string, Array>& arrays, const std::string& path)
+{
+	std::string buf;
+	readFile(buf, path);
+	const char *p = buf.data();
+	const size_t n = buf.size();
+	/* end of central directory */
+	size_t eocd = n < 22 ? 0 : n - 22;
+	while (eocd > 0 && local::get32(p + eocd) != 0x06054b50) eocd--;
+	if (n < 22 || local::get32(p + eocd) != 0x06054b50) {
+		NpyException e;
+		e << "not zip" << path;
+		throw e;
+	}
+	const size_t num = local::get16(p + eocd + 10);
+	size_t cd = local::get32(p + eocd + 16);
+	for (size_t i = 0; i < num; i++) {
+		if (cd + 46 > n || local::get32(p + cd) != 0x02014b50) throw NpyException() << "bad central directory" << path;
+		const uint32_t method = local::get16(p + cd + 10);
+		uint64_t size = local::get32(p + cd + 24);
+		uint64_t offset = local::get32(p + cd + 42);
+		const size_t nameLen = local::get16(p + cd + 28);
+		const size_t extraLen = local::get16(p + cd + 30);
+		const size_t commentLen = local::get16(p + cd + 32);
+		std::string name(p + cd + 46, nameLen);
+		/* zip64 extended information */
+		for (size_t e = cd + 46 + nameLen; e + 4 <= cd + 46 + nameLen + extraLen; ) {
+			const uint32_t id = local::get16(p + e), len = local::get16(p + e + 2);
+			if (id == 1) {
+				const char *q = p + e + 4;
+				if (size == 0xffffffff) { size = local::get64(q); q += 8; }
+				if (local::get32(p + cd + 20) == 0xffffffff) q += 8;
+				if (offset == 0xffffffff) offset = local::get64(q);
+			}
+			e += 4 + len;
+		}
+		cd += 46 + nameLen + extraLen + commentLen;
+		if (method != 0) {
+			NpyException e;
+			e << "compressed npz is not supported" << path;
+			throw e;
+		}
+		if (offset + 30 > n) throw NpyException() << "bad local header" << path;
+		const size_t data = offset + 30 + local::get16(p + offset + 26) + local::get16(p + offset + 28);
+		if (data + size > n) throw NpyException() << "short data" << path;
+		if (name.size() > 4 && name.compare(name.size() - 4, 4, ".npy") == 0) name.resize(name.size() - 4);
+		parse(arrays[name], p + data, (size_t)size);
+	}
+}
+
+/**
+	save 2-dimensional double matrix as .npy
+	@param path [in] .npy file
+	@param p [in] row-major matrix
+	@param rows [in] number of rows
+	@param cols [in] number of columns
+*/
+inline void saveMatrix(const std::string& path, const double *p, size_t rows, size_t cols)
+{
+	char shape[64];
+	CYBOZU_SNPRINTF(shape, sizeof(shape), "(%llu, %llu)", (unsigned long long)rows, (unsigned long long)cols);
+	std::string header = std::string("{'descr': '<f8', 'fortran_order': False, 'shape': ") + shape + ", }";
+	/* total header size is aligned to 16 bytes, terminated by '\n' */
+	while ((10 + header.size() + 1) % 16 != 0) header += ' ';
+	header += '\n';
+	std::ofstream ofs(path.c_str(), std::ios::binary);
+	if (!ofs) {
+		NpyException e;
+		e << "can't open" << path;
+		throw e;
+	}
+	const char magic[] = { '\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0, (char)(header.size() & 0xff), (char)(header.size() >> 8) };
+	ofs.write(magic, sizeof(magic));
+	ofs.write(header.data(), header.size());
+	ofs.write((const char *)p, rows * cols * sizeof(double));
+	if (!ofs) {
+		NpyException e;
+		e << "write error" << path;
+		throw e;
+	}
+}
+
+/**
+	image of .npy of array a
+*/
+inline void encode(std::string& out, const Array& a)
+{
+	std::string shape = "(";
+	char buf[32];
+	for (size_t i = 0; i < a.shape.size(); i++) {
+		CYBOZU_SNPRINTF(buf, sizeof(buf), "%llu,%s", (unsigned long long)a.shape[i], i + 1 < a.shape.size() ? " " : "");
+		shape += buf;
+	}
+	if (a.shape.size() > 1) shape.resize(shape.size() - 1); /* (n,) or (n, m) */
+	shape += ")";
+	std::string header = "{'descr': '" + a.descr + "', 'fortran_order': False, 'shape': " + shape + ", }";
+	while ((10 + header.size() + 1) % 16 != 0) header += ' ';
+	header += '\n';
+	const char magic[] = { '\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0, (char)(header.size() & 0xff), (char)(header.size() >> 8) };
+	out.assign(magic, sizeof(magic));
+	out += header;
+	out += a.data;
+}
+
+namespace local {
+
+inline void put16(std::string& out, uint32_t v) { out += (char)(v & 0xff); out += (char)((v >> 8) & 0xff); }
+inline void put32(std::string& out, uint32_t v) { put16(out, v & 0xffff); put16(out, v >> 16); }
+
+} // local
+
+/**
+	image of .npz of arrays (numpy.savez, not compressed, less than 4GB)
+	@param arrays [in] name(without .npy) => array
+*/
+inline void encodeNpz(std::string& zip, const std::map<std::string, Array>& arrays)
+{
+	std::string cd, npy;
+	zip.clear();
+	for (std::map<std::string, Array>::const_iterator i = arrays.begin(); i != arrays.end(); ++i) {
+		const std::string name = i->first + ".npy";
+		encode(npy, i->second);
+		const uint32_t crc = gzip::crc32(0, npy.data(), npy.size());
+		const uint32_t offset = (uint32_t)zip.size();
+		/* local file header */
+		local::put32(zip, 0x04034b50);
+		local::put16(zip, 20); local::put16(zip, 0); local::put16(zip, 0); /* version, flags, stored */
+		local::put16(zip, 0); local::put16(zip, 0x21); /* time, date (1980-01-01) */
+		local::put32(zip, crc); local::put32(zip, (uint32_t)npy.size()); local::put32(zip, (uint32_t)npy.size());
+		local::put16(zip, (uint32_t)name.size()); local::put16(zip, 0);
+		zip += name;
+		zip += npy;
+		/* central directory header */
+		local::put32(cd, 0x02014b50);
+		local::put16(cd, 20); local::put16(cd, 20); local::put16(cd, 0); local::put16(cd, 0);
+		local::put16(cd, 0); local::put16(cd, 0x21);
+		local::put32(cd, crc); local::put32(cd, (uint32_t)npy.size()); local::put32(cd, (uint32_t)npy.size());
+		local::put16(cd, (uint32_t)name.size()); local::put16(cd, 0); local::put16(cd, 0); /* name, extra, comment */
+		local::put16(cd, 0); local::put16(cd, 0); local::put32(cd, 0); /* disk, attributes */
+		local::put32(cd, offset);
+		cd += name;
+	}
+	const uint32_t cdOffset = (uint32_t)zip.size();
+	zip += cd;
+	/* end of central directory */
+	local::put32(zip, 0x06054b50);
+	local::put16(zip, 0); local::put16(zip, 0);
+	local::put16(zip, (uint32_t)arrays.size()); local::put16(zip, (uint32_t)arrays.size());
+	local::put32(zip, (uint32_t)cd.size()); local::put32(zip, cdOffset);
+	local::put16(zip, 0);
+}
+
+/**
+	save arrays as .npz file
+*/
+inline void saveNpz(const std::string& path, const std::map<std::string, Array>& arrays)
+{
+	std::string zip;
+	encodeNpz(zip, arrays);
+	std::ofstream ofs(path.c_str(), std::ios::binary);
+	if (!ofs) {
+		NpyException e;
+		e << "can't open" << path;
+		throw e;
+	}
+	ofs.write(zip.data(), zip.size());
+	if (!ofs) {
+		NpyException e;
+		e << "write error" << path;
+		throw e;
+	}
+}
+
+} } // ldig::npy
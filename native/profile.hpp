@@ -0,0 +1,145 @@
+#pragma once
+/**
+	@file
+	@brief profile of feature extraction (hits of features and depth of trie walks)
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include "model.hpp"
+#include "metrics.hpp"
+
+namespace ldig {
+
+/**
+	profile of a thread, passed to Model::extract as the walker
+	(written by the thread only, and read by the others at any time)
+*/
+class WalkProfile {
+public:
+	static const size_t depthN = 64;  //!< walks by transitions (the last is depthN - 1 or more)
+	static const size_t bucketN = 32; //!< texts by transitions in buckets of powers of 2 ([0], [1], [2, 3], ...)
+private:
+	size_t M_;
+	std::unique_ptr<Counter[]> hits_;
+	Counter depth_[depthN];
+	Counter texts_[bucketN];
+	uint32_t walks_[depthN]; //!< of the current text
+	size_t transitions_; //!< of the current text
+	WalkProfile(const WalkProfile&);
+	void operator=(const WalkProfile&);
+public:
+	explicit WalkProfile(size_t M) : M_(M), hits_(new Counter[M]), transitions_(0)
+	{
+		std::fill(walks_, walks_ + depthN, 0);
+	}
+	size_t size() const { return M_; }
+	static size_t bucket(uint64_t transitions)
+	{
+		size_t b = 0;
+		while (transitions > 0 && b < bucketN - 1) {
+			transitions >>= 1;
+			b++;
+		}
+		return b;
+	}
+	void operator()(size_t transitions)
+	{
+		walks_[std::min(transitions, depthN - 1)]++;
+		transitions_ += transitions;
+	}
+	/**
+		end of the walks of a text
+		@param events [in] features extracted from the text
+	*/
+	void endText(const Events& events)
+	{
+		for (size_t i = 0; i < events.size(); i++) hits_[events[i].id].add(events[i].count);
+		for (size_t i = 0; i < depthN; i++) {
+			if (walks_[i] == 0) continue;
+			depth_[i].add(walks_[i]);
+			walks_[i] = 0;
+		}
+		texts_[bucket(transitions_)].add(1);
+		transitions_ = 0;
+	}
+	uint64_t hits(size_t id) const { return hits_[id].get(); }
+	uint64_t depth(size_t i) const { return depth_[i].get(); }
+	uint64_t texts(size_t i) const { return texts_[i].get(); }
+};
+
+/**
+	sum of the profiles of threads, saved as .npz (int64 arrays):
+	- hits : (M,) frequency of each feature
+	- depth : (depthN,) walks by transitions
+	- text_transitions : (bucketN,) texts by transitions in buckets of powers of 2
+	- trie_hash : (1,) Model::trieHash of the model profiled (bits of uint64)
+*/
+struct Profile {
+	uint64_t trieHash;
+	std::vector<uint64_t> hits;
+	std::vector<uint64_t> depth;
+	std::vector<uint64_t> textTransitions;
+
+	Profile() : trieHash(0) { }
+	void add(const WalkProfile& p)
+	{
+		hits.resize(p.size());
+		depth.resize(WalkProfile::depthN);
+		textTransitions.resize(WalkProfile::bucketN);
+		for (size_t i = 0; i < hits.size(); i++) hits[i] += p.hits(i);
+		for (size_t i = 0; i < depth.size(); i++) depth[i] += p.depth(i);
+		for (size_t i = 0; i < textTransitions.size(); i++) textTransitions[i] += p.texts(i);
+	}
+	uint64_t texts() const
+	{
+		uint64_t n = 0;
+		for (size_t i = 0; i < textTransitions.size(); i++) n += textTransitions[i];
+		return n;
+	}
+	void encode(std::string& out) const
+	{
+		std::map<std::string, npy::Array> arrays;
+		set(arrays["hits"], hits);
+		set(arrays["depth"], depth);
+		set(arrays["text_transitions"], textTransitions);
+		set(arrays["trie_hash"], std::vector<uint64_t>(1, trieHash));
+		npy::encodeNpz(out, arrays);
+	}
+	void save(const std::string& path) const
+	{
+		std::string out;
+		encode(out);
+		std::ofstream ofs(path.c_str(), std::ios::binary);
+		ofs.write(out.data(), out.size());
+		if (!ofs) throw cybozu::Exception("profile") << "can't write" << path;
+	}
+	void load(const std::string& path)
+	{
+		std::map<std::string, npy::Array> arrays;
+		npy::loadNpz(arrays, path);
+		if (!arrays.count("hits") || !arrays.count("depth") || !arrays.count("text_transitions") || !arrays.count("trie_hash")) throw cybozu::Exception("profile") << "not profile" << path;
+		std::vector<int64_t> v;
+		arrays["hits"].get(v);
+		hits.assign(v.begin(), v.end());
+		arrays["depth"].get(v);
+		depth.assign(v.begin(), v.end());
+		arrays["text_transitions"].get(v);
+		textTransitions.assign(v.begin(), v.end());
+		arrays["trie_hash"].get(v);
+		trieHash = v.empty() ? 0 : (uint64_t)v[0];
+	}
+private:
+	static void set(npy::Array& a, const std::vector<uint64_t>& v)
+	{
+		a.descr = "<i8";
+		a.shape.assign(1, v.size());
+		a.data.assign(v.empty() ? "" : (const char *)&v[0], v.size() * sizeof(uint64_t));
+	}
+};
+
+} // ldig
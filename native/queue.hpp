@@ -0,0 +1,49 @@
+#pragma once
+/**
+	@file
+	@brief blocking queue with bounded capacity
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace ldig {
+
+template<class T>
+class BoundedQueue {
+	std::mutex mutex_;
+	std::condition_variable notEmpty_;
+	std::condition_variable notFull_;
+	std::deque<T> queue_;
+	size_t capacity_;
+	BoundedQueue(const BoundedQueue&);
+	void operator=(const BoundedQueue&);
+public:
+	explicit BoundedQueue(size_t capacity) : capacity_(capacity) { }
+	/**
+		wait while the queue is full
+	*/
+	void push(const T& x)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (queue_.size() >= capacity_) notFull_.wait(lock);
+		queue_.push_back(x);
+		notEmpty_.notify_one();
+	}
+	/**
+		wait while the queue is empty
+	*/
+	T pop()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (queue_.empty()) notEmpty_.wait(lock);
+		T x = queue_.front();
+		queue_.pop_front();
+		notFull_.notify_one();
+		return x;
+	}
+};
+
+} // ldig
@@ -0,0 +1,161 @@
+#pragma once
+/**
+	@file
+	@brief segmentation of a text into spans of languages
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "model.hpp"
+
+namespace ldig {
+
+/**
+	span of normalized text [begin, end) detected as label
+*/
+struct Segment {
+	size_t begin;
+	size_t end;
+	size_t label;
+	std::vector<double> y; //!< K probabilities of the span
+};
+
+/**
+	The weights of each feature are divided equally among its characters,
+	so the scores of a span are the difference of the cumulative scores,
+	and the scores of the whole text are the same as Model::predict.
+	The labels of the characters are decoded by Viterbi, which maximizes
+	the total of their scores minus penalty for each change of label.
+	Both are linear in the length of text.
+*/
+class Segmenter {
+	const Model& model_;
+	Segmenter(const Segmenter&);
+	void operator=(const Segmenter&);
+public:
+	/**
+		work area of a thread
+	*/
+	struct Work {
+		cybozu::String buf;
+		std::vector<double> diff; //!< difference of the scores of characters
+		std::vector<double> cum; //!< cumulative scores ((n + 1) x K)
+		std::vector<double> v; //!< Viterbi scores
+		std::vector<uint16_t> back; //!< previous label of each character and label
+	};
+	/**
+		default penalty of change of label
+	*/
+	static double defaultPenalty() { return 10.0; }
+
+	explicit Segmenter(const Model& model) : model_(model)
+	{
+		if (model.K > 65535) throw cybozu::Exception("segmenter") << "too many labels";
+	}
+	/**
+		@param segs [out] spans of normalized text
+		@param text [in] normalized text
+		@param penalty [in] penalty of change of label (larger gives longer spans)
+	*/
+	void segment(std::vector<Segment>& segs, Work& w, const cybozu::String& text, double penalty) const
+	{
+		const DoubleArray& trie = model_.trie;
+		const size_t K = model_.K;
+		cybozu::String& buf = w.buf;
+		buf.clear();
+		buf.push_back(1);
+		buf += text;
+		buf.push_back(1);
+		const size_t n = buf.size();
+
+		/* one extraction pass (same as DoubleArray::extractIds) */
+		w.diff.assign((n + 1) * K, 0);
+		for (size_t i = 0; i < n; i++) {
+			int pointer = 0;
+			for (size_t j = i; j < n; j++) {
+				pointer = trie.child(pointer, (int)buf[j]);
+				if (pointer < 0) break;
+				const int id = trie.value(pointer);
+				if (id < 0) continue;
+				const double *p = &model_.param[id * K];
+				const double r = 1.0 / (j + 1 - i);
+				double *a = &w.diff[i * K];
+				double *b = &w.diff[(j + 1) * K];
+				for (size_t k = 0; k < K; k++) {
+					a[k] += p[k] * r;
+					b[k] -= p[k] * r;
+				}
+			}
+		}
+
+		/* scores of characters (diff is overwritten) and cumulative scores */
+		w.cum.assign((n + 1) * K, 0);
+		for (size_t i = 0; i < n; i++) {
+			double *c = &w.diff[i * K];
+			if (i > 0) {
+				const double *prev = &w.diff[(i - 1) * K];
+				for (size_t k = 0; k < K; k++) c[k] += prev[k];
+			}
+			for (size_t k = 0; k < K; k++) w.cum[(i + 1) * K + k] = w.cum[i * K + k] + c[k];
+		}
+
+		/* Viterbi */
+		w.v.assign(w.diff.begin(), w.diff.begin() + K);
+		w.back.resize(n * K);
+		for (size_t i = 1; i < n; i++) {
+			const size_t best = std::max_element(w.v.begin(), w.v.end()) - w.v.begin();
+			const double change = w.v[best] - penalty;
+			const double *c = &w.diff[i * K];
+			uint16_t *back = &w.back[i * K];
+			for (size_t k = 0; k < K; k++) {
+				if (w.v[k] >= change) {
+					back[k] = (uint16_t)k;
+				} else {
+					w.v[k] = change;
+					back[k] = (uint16_t)best;
+				}
+				w.v[k] += c[k];
+			}
+		}
+
+		/* spans of characters from the end, then to positions in text */
+		segs.clear();
+		size_t label = std::max_element(w.v.begin(), w.v.end()) - w.v.begin();
+		size_t end = n;
+		for (size_t i = n - 1; ; i--) {
+			const size_t prev = i > 0 ? w.back[i * K + label] : label;
+			if (i == 0 || prev != label) {
+				Segment s;
+				s.begin = i;
+				s.end = end;
+				s.label = label;
+				segs.push_back(s);
+				end = i;
+				label = prev;
+			}
+			if (i == 0) break;
+		}
+		std::reverse(segs.begin(), segs.end());
+		for (size_t i = 0; i < segs.size(); i++) {
+			Segment& s = segs[i];
+			s.y.resize(K);
+			for (size_t k = 0; k < K; k++) s.y[k] = w.cum[s.end * K + k] - w.cum[s.begin * K + k];
+			Model::softmax(&s.y[0], K);
+			/* without the boundary marks */
+			s.begin = s.begin > 0 ? s.begin - 1 : 0;
+			s.end = std::min(s.end - 1, text.size());
+		}
+		/* a span of only a boundary mark */
+		for (size_t i = 0; i < segs.size(); ) {
+			if (segs[i].begin == segs[i].end && segs.size() > 1) {
+				segs.erase(segs.begin() + i);
+			} else {
+				i++;
+			}
+		}
+	}
+};
+
+} // ldig
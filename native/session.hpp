@@ -0,0 +1,185 @@
+#pragma once
+/**
+	@file
+	@brief incremental detection of a text which is edited at its end
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include "model.hpp"
+
+namespace ldig {
+
+/**
+	A session keeps the state of feature extraction (DoubleArray::extractIds) of
+	u0001 + text after each character: the scores, and the cursors of trie
+	which are the nodes of the substrings ending there.
+	Appending a character only advances the cursors and starts a new one from the root,
+	and the other edits go back to the state of the common prefix and append the rest.
+	The end mark (u0001) is applied to a copy of the last state for prediction.
+	@note the scores are summed in the order of the text, so the probabilities
+	may differ from Model::predict in the last bits
+*/
+class Session {
+	const Model& model_;
+	cybozu::String text_; //!< u0001 + text
+	std::vector<double> z_; //!< scores after each character ((size + 1) x K)
+	std::vector<int> cursors_; //!< cursors after each character
+	std::vector<size_t> cursorBegin_; //!< offset of cursors_ for each state
+	std::vector<int> ids_; //!< features found at each character
+	std::vector<size_t> idBegin_; //!< offset of ids_ for each state
+	std::unordered_map<int, int> counts_; //!< frequency of each feature in ids_
+	std::vector<int> next_; //!< work area
+
+	void truncate(size_t n)
+	{
+		for (size_t i = idBegin_[n + 1]; i < ids_.size(); i++) {
+			std::unordered_map<int, int>::iterator p = counts_.find(ids_[i]);
+			if (--p->second == 0) counts_.erase(p);
+		}
+		text_.resize(n);
+		z_.resize((n + 1) * model_.K);
+		cursors_.resize(cursorBegin_[n + 1]);
+		cursorBegin_.resize(n + 2);
+		ids_.resize(idBegin_[n + 1]);
+		idBegin_.resize(n + 2);
+	}
+	/*
+		advance the cursors of the last state (and the root) by c
+		@param f [in] f(id) for each feature found
+		@param next [out] new cursors (0 not to keep)
+	*/
+	template<class F>
+	void advance(F& f, std::vector<int> *next, cybozu::Char c) const
+	{
+		const DoubleArray& trie = model_.trie;
+		const size_t n = text_.size();
+		for (size_t i = cursorBegin_[n]; i <= cursors_.size(); i++) {
+			/* the root is the last */
+			const int pointer = trie.child(i < cursors_.size() ? cursors_[i] : 0, (int)c);
+			if (pointer < 0) continue;
+			const int id = trie.value(pointer);
+			if (id >= 0) f(id);
+			if (next) next->push_back(pointer);
+		}
+	}
+	struct Append {
+		Session& s;
+		double *z;
+		explicit Append(Session& s, double *z) : s(s), z(z) { }
+		void operator()(int id)
+		{
+			const double *w = &s.model_.param[id * s.model_.K];
+			for (size_t k = 0; k < s.model_.K; k++) z[k] += w[k];
+			s.ids_.push_back(id);
+			s.counts_[id]++;
+		}
+	};
+	struct End {
+		const Model& model;
+		double *y;
+		Events *events;
+		End(const Model& model, double *y, Events *events) : model(model), y(y), events(events) { }
+		void operator()(int id)
+		{
+			const double *w = &model.param[id * model.K];
+			for (size_t k = 0; k < model.K; k++) y[k] += w[k];
+			if (events) {
+				const Event e = { id, 1 };
+				events->push_back(e);
+			}
+		}
+	};
+	static bool byId(const Event& a, const Event& b) { return a.id < b.id; }
+
+	void append(cybozu::Char c)
+	{
+		const size_t K = model_.K;
+		const size_t n = text_.size();
+		z_.resize(z_.size() + K);
+		double *z = &z_[(n + 1) * K];
+		std::copy(z - K, z, z);
+		next_.clear();
+		Append f(*this, z);
+		advance(f, &next_, c);
+		text_.push_back(c);
+		cursors_.insert(cursors_.end(), next_.begin(), next_.end());
+		cursorBegin_.push_back(cursors_.size());
+		idBegin_.push_back(ids_.size());
+	}
+	Session(const Session&);
+	void operator=(const Session&);
+public:
+	explicit Session(const Model& model)
+		: model_(model), z_(model.K), cursorBegin_(2), idBegin_(2)
+	{
+	}
+	/**
+		number of characters of the text (with the beginning mark)
+	*/
+	size_t size() const { return text_.size(); }
+	/**
+		bytes of the state (allocated, so a shortened text keeps its largest size)
+	*/
+	size_t bytes() const
+	{
+		return sizeof(*this) + text_.capacity() * sizeof(cybozu::Char) + z_.capacity() * sizeof(double)
+			+ (cursors_.capacity() + ids_.capacity() + next_.capacity()) * sizeof(int)
+			+ (cursorBegin_.capacity() + idBegin_.capacity()) * sizeof(size_t)
+			+ counts_.size() * (sizeof(std::pair<const int, int>) + 2 * sizeof(void*)) + counts_.bucket_count() * sizeof(void*);
+	}
+	/**
+		change the text to the normalized text
+		@return number of characters reused (with the beginning mark)
+	*/
+	size_t update(const cybozu::String& text)
+	{
+		size_t n = 0;
+		if (!text_.empty()) {
+			n = 1;
+			while (n < text_.size() && n - 1 < text.size() && text_[n] == text[n - 1]) n++;
+			truncate(n);
+		} else {
+			append(1);
+		}
+		for (size_t i = n > 0 ? n - 1 : 0; i < text.size(); i++) append(text[i]);
+		return n;
+	}
+	/**
+		probabilities of the text (same as Model::extract and Model::predict)
+		@param y [out] K probabilities
+		@param events [out] features with their frequencies sorted by id if not 0
+	*/
+	void predict(double *y, Events *events = 0) const
+	{
+		const size_t K = model_.K;
+		std::copy(&z_[text_.size() * K], &z_[text_.size() * K] + K, y);
+		if (events) {
+			events->clear();
+			for (std::unordered_map<int, int>::const_iterator i = counts_.begin(); i != counts_.end(); ++i) {
+				const Event e = { i->first, i->second };
+				events->push_back(e);
+			}
+		}
+		End f(model_, y, events);
+		advance(f, 0, 1);
+		if (events) {
+			/* merge the features of the end mark */
+			std::sort(events->begin(), events->end(), byId);
+			size_t j = 0;
+			for (size_t i = 0; i < events->size(); i++) {
+				if (j > 0 && (*events)[j - 1].id == (*events)[i].id) {
+					(*events)[j - 1].count += (*events)[i].count;
+				} else {
+					(*events)[j++] = (*events)[i];
+				}
+			}
+			events->resize(j);
+		}
+		Model::softmax(y, K);
+	}
+};
+
+} // ldig
@@ -0,0 +1,51 @@
+#pragma once
+/**
+	@file
+	@brief scoring restricted to a subset of labels
+
+	Copyright (C) 2012 Nakatani Shuyo / Cybozu Labs, Inc., all rights reserved.
+*/
+#include <vector>
+#include "model.hpp"
+
+namespace ldig {
+
+/**
+	the scoring reads and adds only the weights of the labels in the rows of the features of the text
+	(O(events x S) without copying the parameters, so any subset costs nothing to make).
+	the probabilities are softmax of the scores of the labels.
+*/
+class LabelSubset {
+	const Model& model_;
+	std::vector<int> labels_; //!< indices of labels in model
+	LabelSubset(const LabelSubset&);
+	void operator=(const LabelSubset&);
+public:
+	/**
+		@param labels [in] indices of labels (unique)
+	*/
+	LabelSubset(const Model& model, const std::vector<int>& labels)
+		: model_(model), labels_(labels)
+	{
+	}
+	const std::vector<int>& labels() const { return labels_; }
+	size_t size() const { return labels_.size(); }
+	/**
+		prediction probability restricted to the labels
+		@param y [out] S probabilities
+	*/
+	void predict(double *y, const Events& events) const
+	{
+		const size_t S = labels_.size();
+		for (size_t s = 0; s < S; s++) y[s] = 0;
+		const int *labels = &labels_[0];
+		for (size_t i = 0; i < events.size(); i++) {
+			const double *w = &model_.param[events[i].id * model_.K];
+			const double freq = events[i].count;
+			for (size_t s = 0; s < S; s++) y[s] += w[labels[s]] * freq;
+		}
+		Model::softmax(y, S);
+	}
+};
+
+} // ldig
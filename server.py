@@ -15,12 +15,6 @@ import ldig
 
 #sys.stdout = codecs.getwriter('utf-8')(sys.stdout)
 
-parser = optparse.OptionParser()
-parser.add_option("-m", dest="model", help="model directory")
-parser.add_option("-p", dest="port", help="listening port number", type="int", default=48000)
-(options, args) = parser.parse_args()
-if not options.model: parser.error("need model directory (-m)")
-
 
 class Detector(object):
     def __init__(self, modeldir):
@@ -30,22 +24,39 @@ class Detector(object):
         self.labels = self.ldig.load_labels()
         self.param = numpy.load(self.ldig.param)
 
-    def detect(self, st):
+    def label_indexes(self, names):
+        """indexes of comma separated label names (None if empty or all labels)"""
+        indexes = set()
+        for x in names.split(","):
+            if x == "": continue
+            if x not in self.labels: raise ValueError("unknown label : %s" % x)
+            indexes.add(self.labels.index(x))
+        if len(indexes) == 0 or len(indexes) == len(self.labels): return None
+        return sorted(indexes)
+
+    def detect(self, st, explain=False, labels=None):
+        """labels : indexes of labels to restrict the softmax (None for all labels)"""
         label, text, org_text = ldig.normalize_text(st)
         events = self.trie.extract_features(u"\u0001" + text + u"\u0001")
-        sum = numpy.zeros(len(self.labels))
+        if labels is None: labels = range(len(self.labels))
+        sum = numpy.zeros(len(labels))
 
         data = []
-        for id in sorted(events, key=lambda id:self.features[id][0]):
-            phi = self.param[id,]
-            sum += phi * events[id]
-            data.append({"id":int(id), "feature":self.features[id][0], "phi":["%0.3f" % x for x in phi]})
+        if explain:
+            for id in sorted(events, key=lambda id:self.features[id][0]):
+                phi = self.param[id, labels]
+                sum += phi * events[id]
+                data.append({"id":int(id), "feature":self.features[id][0], "phi":["%0.3f" % x for x in phi]})
+        elif len(events) > 0:
+            sum += numpy.dot(events.values(), self.param[events.keys(),][:, labels])
         exp_w = numpy.exp(sum - sum.max())
         prob = exp_w / exp_w.sum()
-        return {"labels":self.labels, "data":data, "prob":["%0.3f" % x for x in prob]}
+        result = {"label":self.labels[labels[prob.argmax()]], "labels":[self.labels[k] for k in labels], "prob":["%0.3f" % x for x in prob]}
+        if explain: result["data"] = data
+        return result
 
 basedir = os.path.join(os.path.dirname(__file__), "static")
-detector = Detector(options.model)
+detector = None
 
 class LdigServerHandler(BaseHTTPServer.BaseHTTPRequestHandler):
     def do_GET(self):
@@ -56,7 +67,13 @@ class LdigServerHandler(BaseHTTPServer.BaseHTTPRequestHandler):
         if path == "/detect":
             params = urlparse.parse_qs(url.query)
             text = unicode(params['text'][0], 'utf-8')
-            json.dump(detector.detect(text), self.wfile)
+            explain = params.get('explain', ['0'])[0] not in ('0', 'false', 'no')
+            try:
+                labels = detector.label_indexes(params.get('labels', [''])[0])
+            except ValueError, e:
+                self.send_error(400, str(e))
+                return
+            json.dump(detector.detect(text, explain, labels), self.wfile)
         elif os.path.exists(localpath):
             self.send_response(200)
             if path.endswith(".html"):
@@ -71,6 +88,14 @@ class LdigServerHandler(BaseHTTPServer.BaseHTTPRequestHandler):
             self.send_header("Expires", "Fri, 31 Dec 2100 00:00:00 GMT")
             self.end_headers()
 
-server = BaseHTTPServer.HTTPServer(('', options.port), LdigServerHandler)
-print "ready."
-server.serve_forever()
+if __name__ == '__main__':
+    parser = optparse.OptionParser()
+    parser.add_option("-m", dest="model", help="model directory")
+    parser.add_option("-p", dest="port", help="listening port number", type="int", default=48000)
+    (options, args) = parser.parse_args()
+    if not options.model: parser.error("need model directory (-m)")
+
+    detector = Detector(options.model)
+    server = BaseHTTPServer.HTTPServer(('', options.port), LdigServerHandler)
+    print "ready."
+    server.serve_forever()
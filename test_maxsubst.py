@@ -0,0 +1,80 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# Test of maxsubst: the output by lines is that of the whole corpus (--whole)
+# except the substrings over lines, which ldig.init discards
+# (build maxsubst/maxsubst first, see maxsubst/readme.md)
+# This code is available under the MIT License.
+# (c)2012 Nakatani Shuyo / Cybozu Labs Inc.
+
+import unittest
+import os, codecs, random, re, shutil, subprocess, tempfile
+
+basedir = os.path.dirname(os.path.abspath(__file__))
+maxsubst = os.path.join(basedir, "maxsubst", "maxsubst")
+
+# the same filter as ldig.init
+r1 = re.compile(u'.\u0001.')
+
+@unittest.skipUnless(os.path.exists(maxsubst), "maxsubst/maxsubst is not built")
+class TestMaxsubst(unittest.TestCase):
+    def setUp(self):
+        self.temp = tempfile.mkdtemp()
+        self.n = 0
+
+    def tearDown(self):
+        shutil.rmtree(self.temp)
+
+    def path(self):
+        self.n += 1
+        return os.path.join(self.temp, "%d" % self.n)
+
+    def run_maxsubst(self, inputs, whole):
+        output = self.path()
+        args = [maxsubst, "-t", "2"]
+        if whole: args.append("--whole")
+        self.assertEqual(subprocess.call(args + inputs + [output]), 0)
+        with codecs.open(output, "rb", "utf-8") as f:
+            return sorted(line for line in f.read().split(u"\n") if line)
+
+    def check(self, *corpora):
+        inputs = []
+        for corpus in corpora:
+            inputs.append(self.path())
+            with codecs.open(inputs[-1], "wb", "utf-8") as f:
+                f.write(corpus)
+        whole = self.run_maxsubst(inputs, True)
+        bounded = self.run_maxsubst(inputs, False)
+        st = lambda line: line[0:line.index(u"\t")]
+        self.assertEqual(bounded, [line for line in whole if u"\u0001" not in st(line)[1:-1]], repr(corpora))
+        self.assertEqual([line for line in bounded if not r1.search(st(line))], [line for line in whole if not r1.search(st(line))])
+
+    def testLines(self):
+        self.check(u"abc\nabd\nabc\n")
+        self.check(u"ab\nab\nab\nb\n")
+        self.check(u"aaaa\naa\naaa\na\n")
+        self.check(u"the cat sat\non the mat\nthe cat\n")
+        self.check(u"été\nété été\nete\n")
+
+    def testNoNewline(self):
+        self.check(u"abc\nabc")
+        self.check(u"ab")
+        self.check(u"abab\nab", u"ab\nabab")
+
+    def testFiles(self):
+        self.check(u"abc\nbcd\n", u"abc\nbcd\n", u"cd\n")
+        self.check(u"aab\n", u"aab", u"ba\n")
+
+    def testRandom(self):
+        random.seed(1234)
+        for n in range(200):
+            corpora = []
+            for m in range(random.randint(1, 3)):
+                lines = [u"".join(random.choice(u"ab cé") for i in range(random.randint(0, 12))) for j in range(random.randint(1, 60))]
+                corpus = u"\n".join(lines)
+                if random.random() < 0.5: corpus += u"\n"
+                if corpus: corpora.append(corpus)
+            if corpora: self.check(*corpora)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,125 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# Regression test of the native tools against ldig.py and server.py
+# (build native/ldigdetect and native/ldigd first, see native/readme.md)
+# This code is available under the MIT License.
+# (c)2012 Nakatani Shuyo / Cybozu Labs Inc.
+
+import unittest
+import os, sys, codecs, json, shutil, socket, subprocess, tarfile, tempfile
+try:
+    from StringIO import StringIO
+    from urllib import quote, urlopen
+except ImportError:
+    from io import StringIO
+    from urllib.parse import quote
+    from urllib.request import urlopen
+import numpy
+import ldig
+import server
+
+basedir = os.path.dirname(os.path.abspath(__file__))
+ldigdetect = os.path.join(basedir, "native", "ldigdetect")
+ldigd = os.path.join(basedir, "native", "ldigd")
+model_tgz = os.path.join(basedir, "models", "ldig.model.small.tgz")
+
+# lines of corpus : the cases of normalize_text and texts of some labels
+TEXTS = [
+    u"en\tRT @user: RT @foo I'm a Superwoman!!! http://t.co/abc #win",
+    u"en\tahahahahhahahhahahaaaa soooooo funny :-) ^_^ (^o^)",
+    u"en\t&amp; &lt;b&gt; &quot;quoted&quot; &#65;&#x42; &eacute;t&eacute; &unknown;",
+    u"en\tin 2012, 10,000 people paid $3.50 – or 99¢",
+    u"en\tmeta data\tthe text after the last tab is used",
+    u"en\tTHIS IS ALL UPPER CASE WITH TABS  AND   SPACES",
+    u"de\tDas ist ein schönes Haus, straße über Ärger",
+    u"fr\tC'est l'été, où est la forêt ? Ça va très bien",
+    u"es\t¿Dónde está el niño? ¡Qué bueno!",
+    u"tr\tİstanbul'da Iıık, şişli çok güzel ğ",
+    u"ro\tși țară şi ţară în România",
+    u"vi\tTiếng Việt các bạn À Ẻ Õ ý",
+    u"vi\tTiếng Việt các bạn không có dấu",
+    u"pl\tZażółć gęślą jaźń",
+    u"cs\tŘíše česká žluťoučký kůň",
+    u"nl\tIk heb het niet gedaan, maar hij wel!!!",
+    u"sv\tJag älskar å ö och smörgåsbord",
+    u"it\tPerché la città è così bella???",
+    u"pt\tNão sei, então você é ação",
+    u"id\tSaya tidak tahu apa yang terjadi kemarin",
+    u"da\tJeg har ikke set det, men det er godt æøå",
+    u"no\tDet er ikke så lett å være norsk",
+    u"fi\tEn tiedä mitä täällä tapahtuu",
+    u"en\tЗдравствуй γειά 日本語 mixed with English ♥☺",
+    u"en\t!!!???...,,,---___",
+    u"en\tx",
+    u"xx\tunknown label is ignored",
+    u"no label line",
+    u"no label\twith tab",
+    u"en\ttrailing tab\t",
+]
+
+@unittest.skipUnless(os.path.exists(ldigdetect) and os.path.exists(ldigd), "native/ldigdetect and native/ldigd are not built")
+class TestNative(unittest.TestCase):
+    """native tools output the same as ldig.py and server.py"""
+
+    @classmethod
+    def setUpClass(cls):
+        cls.temp = tempfile.mkdtemp()
+        with tarfile.open(model_tgz) as f:
+            f.extractall(cls.temp)
+        cls.model = os.path.join(cls.temp, "model.small")
+        cls.corpus = os.path.join(cls.temp, "corpus.txt")
+        with codecs.open(cls.corpus, "wb", "utf-8") as f:
+            for s in TEXTS:
+                f.write(s + u"\n")
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.temp)
+
+    def native(self, args):
+        p = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        out, err = p.communicate()
+        self.assertEqual(p.returncode, 0, err)
+        return out.decode("utf-8")
+
+    def testNormalize(self):
+        out = self.native([ldigdetect, "--normalize", self.corpus]).split(u"\n")
+        for i, s in enumerate(TEXTS):
+            label, text, org_text = ldig.normalize_text(s + u"\n")
+            self.assertEqual(out[i], u"%s\t%s" % (label, text), s)
+
+    def testDetect(self):
+        detector = ldig.ldig(self.model)
+        stdout = sys.stdout
+        sys.stdout = StringIO()
+        try:
+            ldig.likelihood(numpy.load(detector.param), detector.load_labels(), detector.load_da(), [self.corpus], None)
+            expected = sys.stdout.getvalue()
+        finally:
+            sys.stdout = stdout
+        self.assertEqual(self.native([ldigdetect, "-m", self.model, "-t", "2", self.corpus]), expected)
+
+    def testServer(self):
+        s = socket.socket()
+        s.bind(("127.0.0.1", 0))
+        port = s.getsockname()[1]
+        s.close()
+        p = subprocess.Popen([ldigd, "-m", self.model, "-p", str(port), "-t", "1"], stdout=subprocess.PIPE)
+        try:
+            p.stdout.readline() # ready.
+            detector = server.Detector(self.model)
+            for s in TEXTS:
+                for explain in (False, True):
+                    for labels in ("", "en,de,fr"):
+                        url = "http://127.0.0.1:%d/detect?text=%s&explain=%d&labels=%s" % (port, quote(s.encode("utf-8")), explain, labels)
+                        actual = json.loads(urlopen(url).read().decode("utf-8"))
+                        expected = json.loads(json.dumps(detector.detect(s, explain, detector.label_indexes(labels))))
+                        self.assertEqual(actual, expected, "%s explain=%d labels=%s" % (s, explain, labels))
+        finally:
+            p.terminate()
+            p.wait()
+            p.stdout.close()
+
+if __name__ == '__main__':
+    unittest.main()